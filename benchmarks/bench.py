@@ -0,0 +1,189 @@
+"""
+Throughput benchmark suite for wsdatautil.
+
+Measures frames/sec and GB/s for ``masking``, ``build``, ``parse`` and
+``ProgressiveStreamReader.feed`` across the payload size matrix
+(0, 125, 64 KB, 1 MB, 16 MB; masked and unmasked; TEXT and BINARY;
+single-frame and batched) and reports which SIMD masking kernel the
+host resolved.
+
+Run via ``make benchmark`` or directly:
+
+    python benchmarks/bench.py                               # print a report
+    python benchmarks/bench.py --save benchmarks/baseline.json
+    python benchmarks/bench.py --compare benchmarks/baseline.json --threshold 0.85
+
+``--compare`` exits non-zero if any case drops below
+``threshold * baseline`` throughput — the release gate.
+
+The timing core is self-contained (calibrated loops, best of
+``--repeat`` rounds); no third-party benchmark harness is required.
+"""
+
+import argparse
+import json
+import platform
+import sys
+import time
+
+import wsdatautil
+from wsdatautil import _wsframecoder
+
+
+SIZES = (
+    (0, "0B"),
+    (125, "125B"),
+    (64 * 1024, "64KB"),
+    (1024 * 1024, "1MB"),
+    (16 * 1024 * 1024, "16MB"),
+)
+
+MASK = b"\x12\x34\x56\x78"
+
+MIN_CASE_TIME = 0.05
+
+
+def _timeit(func, repeat):
+    """calibrated best-of-`repeat` seconds per call of `func`"""
+    loops = 1
+    while True:
+        t0 = time.perf_counter()
+        for _ in range(loops):
+            func()
+        elapsed = time.perf_counter() - t0
+        if elapsed >= MIN_CASE_TIME:
+            break
+        loops *= 2
+    best = elapsed
+    for _ in range(repeat - 1):
+        t0 = time.perf_counter()
+        for _ in range(loops):
+            func()
+        best = min(best, time.perf_counter() - t0)
+    return best / loops
+
+
+def _cases():
+    """yields (name, func, frames_per_call, payload_bytes_per_call)"""
+    for size, label in SIZES:
+        payload = b"a" * size
+
+        if size:
+            yield (
+                "masking/%s" % label,
+                lambda payload=payload: _wsframecoder.masking(payload, MASK),
+                1, size,
+            )
+
+        for masked, mask in ((0, b""), (1, MASK)):
+            mask_label = "masked" if masked else "unmasked"
+            for opcode, op_label in ((wsdatautil.OPCODES.TEXT, "TEXT"), (wsdatautil.OPCODES.BINARY, "BINARY")):
+                yield (
+                    "build/%s/%s/%s" % (label, mask_label, op_label),
+                    lambda payload=payload, mask=mask, opcode=opcode:
+                        _wsframecoder.build(1, 0, 0, 0, opcode, mask, payload),
+                    1, size,
+                )
+
+                frame = _wsframecoder.build(1, 0, 0, 0, opcode, mask, payload)
+                yield (
+                    "parse/%s/%s/%s/single" % (label, mask_label, op_label),
+                    lambda frame=frame: _wsframecoder.parse(frame, True),
+                    1, size,
+                )
+                batch = 2 if size >= 16 * 1024 * 1024 else 8
+                stream = frame * batch
+                yield (
+                    "parse/%s/%s/%s/batched" % (label, mask_label, op_label),
+                    lambda stream=stream: _wsframecoder.parse_all(stream, True),
+                    batch, size * batch,
+                )
+
+            frame = _wsframecoder.build(1, 0, 0, 0, wsdatautil.OPCODES.BINARY, mask, payload)
+            batch = 2 if size >= 16 * 1024 * 1024 else 8
+            stream = frame * batch
+            reader = wsdatautil.ProgressiveStreamReader(bool(masked))
+
+            yield (
+                "reader/%s/%s/batched" % (label, mask_label),
+                lambda reader=reader, stream=stream: reader.feed(stream),
+                batch, size * batch,
+            )
+
+
+def run(repeat):
+    results = {}
+    for name, func, frames, nbytes in _cases():
+        secs = _timeit(func, repeat)
+        results[name] = {
+            "secs_per_op": secs,
+            "frames_per_sec": frames / secs,
+            "gb_per_sec": nbytes / secs / 1e9,
+        }
+        print("%-38s %12.0f frames/s %10.3f GB/s" % (
+            name, results[name]["frames_per_sec"], results[name]["gb_per_sec"]
+        ))
+    return results
+
+
+def compare(results, baseline, threshold):
+    regressions = []
+    for name, entry in baseline["results"].items():
+        if name not in results:
+            continue
+        current = results[name]["frames_per_sec"]
+        reference = entry["frames_per_sec"]
+        if current < reference * threshold:
+            regressions.append((name, current / reference))
+    if baseline["meta"]["masking_backend"] != _wsframecoder.masking_backend():
+        print("note: baseline was recorded on masking backend %r (now %r)" % (
+            baseline["meta"]["masking_backend"], _wsframecoder.masking_backend()
+        ))
+    if regressions:
+        print()
+        print("REGRESSIONS (below %.0f%% of baseline):" % (threshold * 100))
+        for name, ratio in regressions:
+            print("  %-38s %.0f%% of baseline" % (name, ratio * 100))
+        return 1
+    print()
+    print("no regressions against baseline (threshold %.0f%%)" % (threshold * 100))
+    return 0
+
+
+def main():
+    argp = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    argp.add_argument("--save", metavar="PATH", help="write results as baseline json")
+    argp.add_argument("--compare", metavar="PATH", help="compare against a stored baseline json")
+    argp.add_argument("--threshold", type=float, default=0.85,
+                      help="minimum fraction of baseline throughput (default: 0.85)")
+    argp.add_argument("--repeat", type=int, default=3,
+                      help="timing rounds per case, best is taken (default: 3)")
+    args = argp.parse_args()
+
+    meta = {
+        "wsdatautil": wsdatautil.__version__,
+        "masking_backend": _wsframecoder.masking_backend(),
+        "python": platform.python_version(),
+        "machine": platform.machine(),
+    }
+    print("wsdatautil %s | masking backend: %s | python %s (%s)" % (
+        meta["wsdatautil"], meta["masking_backend"], meta["python"], meta["machine"]
+    ))
+    print()
+
+    results = run(args.repeat)
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump({"meta": meta, "results": results}, f, indent=2)
+        print()
+        print("baseline written to %s" % args.save)
+
+    if args.compare:
+        with open(args.compare) as f:
+            baseline = json.load(f)
+        sys.exit(compare(results, baseline, args.threshold))
+
+
+if __name__ == "__main__":
+    main()
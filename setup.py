@@ -11,7 +11,8 @@ else:
         Extension(
             'wsdatautil._wsframecoder',
             sources=['src/wsdatautil/_wsframecoder.c'],
-            extra_compile_args=['-std=c99']
+            extra_compile_args=['-std=c99'],
+            libraries=['z']
         )
     ]
 
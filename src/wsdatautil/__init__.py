@@ -12,10 +12,9 @@ For the sake of completeness, the ``HandshakeRequest`` object is available.
 
 from __future__ import annotations
 
-from typing import Literal, NamedTuple, Generator, Callable
+from typing import Literal, NamedTuple, Callable, Iterable
 from base64 import b64encode
-from collections import OrderedDict
-from hashlib import sha1
+from collections import OrderedDict, deque
 from uuid import uuid4
 
 from . import _wsframecoder
@@ -24,6 +23,18 @@ from . import _wsframecoder
 __version__ = "1.1"
 
 
+AUTO_MASK = _wsframecoder.AUTO
+"""sentinel for ``Frame.mask``: a fresh mask key is generated in C per build"""
+
+MaskGenerator = _wsframecoder.MaskGenerator
+
+PayloadTooLong = _wsframecoder.PayloadTooLong
+
+RecvBuffer = _wsframecoder.RecvBuffer
+
+FrameParser = _wsframecoder.FrameParser
+
+
 def _make_accept_key(b64key: bytes):
     """The WebSocket Key conversion:
 
@@ -32,11 +43,7 @@ def _make_accept_key(b64key: bytes):
         - The result is hashed with the SHA-1 function.
         - A base64 string is then created from the digest and returned as `<String-Out>`.
     """
-    return b64encode(
-        sha1(
-            b64key + b"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
-        ).digest()
-    )
+    return _wsframecoder.make_accept_key(b64key)
 
 
 class HeaderObj(OrderedDict[bytes, bytes]):
@@ -48,19 +55,15 @@ class HeaderObj(OrderedDict[bytes, bytes]):
         OrderedDict.__init__(self)
 
     def to_streamdata(self):
-        return self.l1 + b"\r\n" + bytes(b"\r\n").join(
-            b"%s: %s" % (k, v)
-            for k, v in self.items()
-        ) + b"\r\n\r\n"
+        return _wsframecoder.build_http_headers(self.l1, list(self.items()))
 
     @classmethod
     def from_streamdata(cls, data: bytes):
+        l1, items = _wsframecoder.parse_http_headers(data)
         new = cls(b"")
-        data = data.strip().split(b"\r\n")
-        new.l1 = data[0]
-        for line in data[1:]:
-            k, v = line.split(b": ")
-            new[k.strip()] = v
+        new.l1 = l1
+        for k, v in items:
+            new[k] = v
         return new
 
 
@@ -122,6 +125,13 @@ class HandshakeRequest(HeaderObj):
             self[b"Sec-WebSocket-Protocol"] = websocket_protocols
         return h
 
+    def make_response_bytes(
+            self,
+            websocket_version: bytes = b"13",
+    ) -> bytes:
+        """fast path: emit the complete minimum 101 response in one C call"""
+        return _wsframecoder.make_response_bytes(self[b"Sec-WebSocket-Key"], websocket_version)
+
 
 class OPCODES:
     CONTINUE = 0
@@ -168,6 +178,16 @@ class CLOSECODES:
     _4000to4999_forApplications = range(4000, 5000)
 
 
+def frames_to_streamdata(frames: Iterable[Frame]) -> bytes:
+    """Generate the stream data of many frames back-to-back
+    in one c call and one contiguous buffer.
+    """
+    return _wsframecoder.build_many([
+        (frame.fin, frame.rsv1, frame.rsv2, frame.rsv3, frame.opcode, frame.mask or b"", frame.payload)
+        for frame in frames
+    ])
+
+
 def get_close_code_and_message_from_frame(frame: Frame) -> tuple[int, bytes]:
     """According to RFC6455, the payload must not exceed a total length of 125 bytes,
     of which the first two bytes are reserved for the numeric code and the rest for
@@ -268,38 +288,52 @@ class Frame(NamedTuple):
     """the actual payload size (regardless of the size type)"""
 
     @classmethod
-    def from_streamdata(cls, data: bytes, auto_demask: bool = True) -> Frame:
+    def from_streamdata(cls, data: bytes, auto_demask: bool = True, view: bool = False, validate_utf8: bool = False) -> Frame:
         """Create the frame object from stream data.
         If `auto_demask` is ``True`` and the mask bit is set,
         unmask the payload directly.
+        If `view` is ``True``, `payload` and `mask` are memoryview slices
+        into `data` instead of copies (the payload is never demasked then,
+        `auto_demask` and `validate_utf8` are ignored); the views keep `data` alive.
+        If `validate_utf8` is ``True``, the payload of a final TEXT frame
+        is checked during the parse and a ``ValueError`` is raised if it
+        is not valid UTF-8.
+
+        The returned object is the c built ``_wsframecoder.Frame``, which
+        is field- and method-compatible with this class.
         """
-        (
-            fin,
-            rsv1,
-            rsv2,
-            rsv3,
-            opcode,
-            masked,
-            amount_spec,
-            amount,
-            mask,
-            payload,
-        ) = _wsframecoder.parse(data, auto_demask)
-        return Frame(
-            payload,
-            opcode,
-            (mask if masked else None),
-            fin,
-            rsv1,
-            rsv2,
-            rsv3,
-            amount_spec,
-            amount
-        )
-
-    def to_streamdata(self) -> bytes:
+        if view:
+            (
+                fin,
+                rsv1,
+                rsv2,
+                rsv3,
+                opcode,
+                masked,
+                amount_spec,
+                amount,
+                mask,
+                payload,
+            ) = _wsframecoder.parse_view(data)
+            return Frame(
+                payload,
+                opcode,
+                (mask if masked else None),
+                fin,
+                rsv1,
+                rsv2,
+                rsv3,
+                amount_spec,
+                amount
+            )
+        return _wsframecoder.parse_frame(data, auto_demask, validate_utf8)
+
+    def to_streamdata(self, validate_utf8: bool = False) -> bytes:
         """Generate stream data from the frame object.
         Mask the payload if `self.mask` is set.
+        If `validate_utf8` is ``True``, the payload of a final TEXT frame
+        is checked before building and a ``ValueError`` is raised if it
+        is not valid UTF-8.
         """
         return _wsframecoder.build(
             self.fin,
@@ -309,7 +343,28 @@ class Frame(NamedTuple):
             self.opcode,
             self.mask or b"",
             self.payload,
+            validate_utf8,
+        )
+
+    def to_streamdata_vector(self) -> tuple[bytes, bytes]:
+        """Generate stream data from the frame object as a
+        ``(header, payload)`` pair ready for scatter-gather io
+        (``socket.sendmsg``/``os.writev``).
+        Mask the payload if `self.mask` is set; an unmasked payload
+        is passed through verbatim without a copy.
+        """
+        header = _wsframecoder.build_header(
+            self.fin,
+            self.rsv1,
+            self.rsv2,
+            self.rsv3,
+            self.opcode,
+            self.mask or b"",
+            len(self.payload),
         )
+        if self.mask:
+            return header, self.masked_payload()
+        return header, self.payload
 
     def masked_payload(self) -> bytes:
         """Apply the `self.mask` to the `self.payload`.
@@ -317,12 +372,35 @@ class Frame(NamedTuple):
         return _wsframecoder.masking(self.payload, self.mask or b"")
 
 
+def _cframe_replace(self, **kwargs) -> Frame:
+    """``NamedTuple._replace`` equivalent for the c built frame
+    (returns a python ``Frame``).
+    """
+    values = {field: getattr(self, field) for field in Frame._fields}
+    values.update(kwargs)
+    return Frame(**values)
+
+
+# the c built _wsframecoder.Frame shares the field names and order of
+# the NamedTuple; attaching the coding methods makes both
+# interchangeable without a second object construction per parse
+_wsframecoder.Frame.to_streamdata = Frame.to_streamdata
+_wsframecoder.Frame.to_streamdata_vector = Frame.to_streamdata_vector
+_wsframecoder.Frame.masked_payload = Frame.masked_payload
+_wsframecoder.Frame._fields = Frame._fields
+_wsframecoder.Frame._replace = _cframe_replace
+
+
 class ProgressiveStreamReader:
     """
     This object serves as a container for progressively read data from the stream.
 
     The constructor accepts an argument that defines whether the payload data in the stream is masked.
 
+    The state machine itself runs as the c implemented ``_wsframecoder.StreamReader``,
+    which buffers incomplete data internally; ``progressive_read`` and ``feed`` therefore
+    accept chunks of any size.
+
     The steps:
 
         - First, the first two bytes (frame header) must be read in:
@@ -393,18 +471,99 @@ class ProgressiveStreamReader:
         """
         return self._make_frame_(payload)
 
-    def _progress(self) -> Generator[int | Frame, bytes, None]:
-        first_two_bytes: bytes = yield
-        if con := self.read_header(first_two_bytes):
-            yield con
-            con_dat: bytes = yield
-            yield self.read_header_continuation(con_dat)
-        else:
-            yield self.amount
-        payload: bytes = yield
-        yield self.make_frame(payload)
+    _reader_: _wsframecoder.StreamReader
+    _frames_: deque[Frame]
+
+    def _frame_from_c_(self, parsed: tuple) -> Frame:
+        (
+            fin,
+            rsv1,
+            rsv2,
+            rsv3,
+            opcode,
+            masked,
+            amount_spec,
+            amount,
+            mask,
+            payload,
+        ) = parsed
+        self.fin = fin
+        self.rsv1 = rsv1
+        self.rsv2 = rsv2
+        self.rsv3 = rsv3
+        self.opcode = opcode
+        self.masked = True if masked & 1 else False
+        self.amount_spec = amount_spec
+        self.amount = amount
+        self.mask = mask if masked else None
+        return Frame(
+            payload,
+            opcode,
+            self.mask,
+            fin,
+            rsv1,
+            rsv2,
+            rsv3,
+            amount_spec,
+            amount,
+        )
+
+    def feed(self, data: bytes) -> list[Frame]:
+        """Consume a chunk of stream data of any size in a single c call
+        and return the list of frames completed by it (may be empty).
+        """
+        return [self._frame_from_c_(parsed) for parsed in self._reader_.feed(data)]
+
+    def feed_payload_chunks(self, data: bytes) -> list[tuple[bytes, int]]:
+        """Consume a chunk of stream data of any size and yield demasked
+        payload bytes incrementally, without buffering whole frames.
 
-    _progressive_read_: Generator[int | Frame, bytes, None]
+        Returns a list of ``(payload_chunk, remaining)`` pairs where
+        `remaining` is the number of payload bytes of the current frame
+        still missing; ``remaining == 0`` marks the frame boundary and the
+        header values (`opcode`, `fin`, ...) of that frame are set on the
+        reader. Masked payloads are demasked with the mask offset carried
+        across chunks (``_wsframecoder.masking_offset``).
+
+        Do not mix with ``feed``/``progressive_read``, which buffer their
+        own stream data.
+        """
+        self._chunk_buf_ += data
+        out = []
+        while True:
+            if self._chunk_phase_ == 0:
+                if len(self._chunk_buf_) < 2:
+                    break
+                continuation = self.read_header(bytes(self._chunk_buf_[:2]))
+                del self._chunk_buf_[:2]
+                if continuation:
+                    self._chunk_phase_ = 1
+                    continue
+                self._chunk_phase_ = 2
+                self._payload_remaining_ = self.amount
+                self._payload_offset_ = 0
+            elif self._chunk_phase_ == 1:
+                if len(self._chunk_buf_) < self.header_continuation:
+                    break
+                self.read_header_continuation(bytes(self._chunk_buf_[:self.header_continuation]))
+                del self._chunk_buf_[:self.header_continuation]
+                self._chunk_phase_ = 2
+                self._payload_remaining_ = self.amount
+                self._payload_offset_ = 0
+            else:
+                take = min(len(self._chunk_buf_), self._payload_remaining_)
+                if not take and self._payload_remaining_:
+                    break
+                chunk = bytes(self._chunk_buf_[:take])
+                del self._chunk_buf_[:take]
+                if self.mask and chunk:
+                    chunk = _wsframecoder.masking_offset(chunk, self.mask, self._payload_offset_)
+                self._payload_offset_ += take
+                self._payload_remaining_ -= take
+                out.append((chunk, self._payload_remaining_))
+                if not self._payload_remaining_:
+                    self._chunk_phase_ = 0
+        return out
 
     def progressive_read(self, data: bytes) -> int | Frame:
         """Can be used to progressively read in the stream data.
@@ -420,46 +579,88 @@ class ProgressiveStreamReader:
                     val = psr.progressive_read(stream.readn(val))
                 ...
         """
-        next(self._progressive_read_)
-        val = self._progressive_read_.send(data)
-        if not isinstance(val, int):
-            self._progressive_read_.close()
-            self._progressive_read_ = self._progress()
-        return val
+        for parsed in self._reader_.feed(data):
+            self._frames_.append(self._frame_from_c_(parsed))
+        if self._frames_:
+            return self._frames_.popleft()
+        return self._reader_.expected
 
     def __init__(
             self,
-            payloads_masked: bool | Literal["auto"]
+            payloads_masked: bool | Literal["auto"],
+            max_payload_len: int = 0,
+            inplace_demask: bool = False
     ):
-        self._progressive_read_ = self._progress()
+        """If `inplace_demask` is ``True``, ``make_frame`` expects a
+        writable buffer (e.g. the bytearray that was recv'd into) and
+        demasks it in place; the payload of the returned ``Frame`` is
+        that same buffer instead of a second full-size copy.
+        """
+        self._reader_ = _wsframecoder.StreamReader(payloads_masked, max_payload_len)
+        self._frames_ = deque()
+        self._chunk_buf_ = bytearray()
+        self._chunk_phase_ = 0
+        self._payload_remaining_ = 0
+        self._payload_offset_ = 0
         if payloads_masked == "auto":
-            def _make_frame(payload: bytes):
-                if self.mask:
-                    payload = Frame(payload, mask=self.mask).masked_payload()
-                return Frame(
-                    payload,
-                    self.opcode,
-                    self.mask,
-                    self.fin,
-                    self.rsv1,
-                    self.rsv2,
-                    self.rsv3,
-                    self.amount_spec,
-                    self.amount,
-                )
+            if inplace_demask:
+                def _make_frame(payload: bytearray):
+                    if self.mask:
+                        _wsframecoder.masking_inplace(payload, self.mask)
+                    return Frame(
+                        payload,
+                        self.opcode,
+                        self.mask,
+                        self.fin,
+                        self.rsv1,
+                        self.rsv2,
+                        self.rsv3,
+                        self.amount_spec,
+                        self.amount,
+                    )
+            else:
+                def _make_frame(payload: bytes):
+                    if self.mask:
+                        payload = Frame(payload, mask=self.mask).masked_payload()
+                    return Frame(
+                        payload,
+                        self.opcode,
+                        self.mask,
+                        self.fin,
+                        self.rsv1,
+                        self.rsv2,
+                        self.rsv3,
+                        self.amount_spec,
+                        self.amount,
+                    )
         elif payloads_masked:
-            def _make_frame(payload: bytes):
-                return Frame(
-                    Frame(payload, mask=self.mask).masked_payload(),
-                    self.opcode,
-                    self.mask,
-                    self.fin,
-                    self.rsv1,
-                    self.rsv2,
-                    self.rsv3,
-                    self.amount_spec,
-                    self.amount,
-                )
+            if inplace_demask:
+                def _make_frame(payload: bytearray):
+                    _wsframecoder.masking_inplace(payload, self.mask)
+                    return Frame(
+                        payload,
+                        self.opcode,
+                        self.mask,
+                        self.fin,
+                        self.rsv1,
+                        self.rsv2,
+                        self.rsv3,
+                        self.amount_spec,
+                        self.amount,
+                    )
+            else:
+                def _make_frame(payload: bytes):
+                    return Frame(
+                        Frame(payload, mask=self.mask).masked_payload(),
+                        self.opcode,
+                        self.mask,
+                        self.fin,
+                        self.rsv1,
+                        self.rsv2,
+                        self.rsv3,
+                        self.amount_spec,
+                        self.amount,
+                    )
         else:
             def _make_frame(payload: bytes):
                 return Frame(
@@ -476,6 +677,166 @@ class ProgressiveStreamReader:
         self._make_frame_ = _make_frame
 
 
+StreamReader = ProgressiveStreamReader
+
+
+class BufferPool:
+    """
+    Pool of recycled bytearrays, bucketed by power-of-two size.
+
+    Intended for the ``_wsframecoder.build_into``/``parse_into`` variants:
+    instead of a fresh object per frame, acquire a buffer at least as large
+    as needed, let the c call fill it and release it afterwards. Recycling
+    the buffers removes the per-frame allocation churn from sustained
+    frame streams.
+    """
+
+    def __init__(self, max_buffers_per_bucket: int = 32):
+        self.max_buffers_per_bucket = max_buffers_per_bucket
+        self._buckets_: dict[int, deque[bytearray]] = {}
+
+    def acquire(self, size: int) -> bytearray:
+        """Return a bytearray of the next power-of-two length >= `size`
+        from the pool, allocating only if the bucket is empty.
+        """
+        bucket_size = 1 << max(size - 1, 1).bit_length()
+        try:
+            return self._buckets_[bucket_size].popleft()
+        except (KeyError, IndexError):
+            return bytearray(bucket_size)
+
+    def release(self, buffer: bytearray) -> None:
+        """Put a buffer back into its bucket (dropped silently if the
+        bucket is full or the length is not a pooled size).
+        """
+        size = len(buffer)
+        if size < 2 or size & (size - 1):
+            # not a power of two: acquire could never hand it out again
+            return
+        bucket = self._buckets_.setdefault(size, deque())
+        if len(bucket) < self.max_buffers_per_bucket:
+            bucket.append(buffer)
+
+
+class MessageAssembler:
+    """
+    Assembles fragmented messages (`fin=0` first fragment, CONTINUE
+    fragments, `fin=1` final) from ``Frame`` objects.
+
+    The payloads are appended to one exponentially grown c buffer inside
+    the ``_wsframecoder.MessageAssembler``, so reassembly costs amortized
+    O(1) allocations instead of one object per fragment; the buffer
+    capacity is kept across messages.
+    """
+
+    def __init__(self):
+        self._assembler = _wsframecoder.MessageAssembler()
+
+    @property
+    def opcode(self) -> int:
+        """Opcode of the message currently being assembled, ``-1`` if idle."""
+        return self._assembler.opcode
+
+    def feed(self, frame: Frame) -> tuple[int, bytes] | None:
+        """Consume one data frame. Returns ``(opcode, payload)`` of the
+        whole message when `frame` completes it, ``None`` otherwise.
+        Control frames raise a ``ValueError`` and must be handled by the
+        caller before feeding.
+        """
+        return self._assembler.feed(frame.fin, frame.opcode, frame.payload)
+
+    def reset(self) -> None:
+        """Discard a partially assembled message."""
+        self._assembler.reset()
+
+
+class PermessageDeflate:
+    """
+    permessage-deflate (RFC 7692) helper, bound to one connection.
+
+    Wraps the c implemented ``_wsframecoder.DeflateContext``, which holds
+    persistent raw deflate and inflate streams, so the compression window
+    is carried from message to message (context takeover) and no
+    per-message compressor objects are allocated.
+
+    ``encode_frame``/``decode_frame`` operate on whole messages: a single
+    unfragmented data frame per call (RFC 7692 applies the compressed
+    stream across all fragments of a message, so fragments must be
+    compressed before fragmenting respectively reassembled before
+    decompressing, e.g. via ``MessageAssembler``); fragmented compressed
+    input raises a ``ValueError``, control frames and frames without
+    `rsv1` pass through unchanged.
+
+    ``acquire``/``release`` maintain process wide pools of reusable
+    instances per (level, window_bits) for servers that take connections
+    up and down at high rates (a released context is reset before reuse).
+    """
+
+    _pools_: dict[tuple[int, int], deque[PermessageDeflate]] = {}
+
+    def __init__(self, level: int = -1, window_bits: int = 15):
+        self.level = level
+        self.window_bits = window_bits
+        self._ctx = _wsframecoder.DeflateContext(level, window_bits)
+
+    def compress(self, payload: bytes) -> bytes:
+        """Compress a message payload (sync flush tail stripped)."""
+        return self._ctx.compress(payload)
+
+    def decompress(self, payload: bytes) -> bytes:
+        """Decompress a message payload."""
+        return self._ctx.decompress(payload)
+
+    def reset(self) -> None:
+        """Drop the sliding windows of both directions (no context takeover)."""
+        self._ctx.reset()
+
+    def encode_frame(self, frame: Frame) -> Frame:
+        """Return an unfragmented data frame with compressed payload and
+        `rsv1` set (control frames pass through unchanged).
+
+        The compressed stream of a message spans all its fragments, so a
+        message must be compressed as a whole before fragmenting;
+        fragmented input raises a ``ValueError``.
+        """
+        if frame.opcode in (OPCODES.TEXT, OPCODES.BINARY):
+            if not frame.fin:
+                raise ValueError("permessage-deflate operates on whole messages: compress before fragmenting")
+            return frame._replace(payload=self._ctx.compress(frame.payload), rsv1=1)
+        if frame.opcode == OPCODES.CONTINUE:
+            raise ValueError("permessage-deflate operates on whole messages: compress before fragmenting")
+        return frame
+
+    def decode_frame(self, frame: Frame) -> Frame:
+        """Return `frame` with decompressed payload if `rsv1` is set.
+
+        A fragmented compressed message (`rsv1` set, `fin` clear) raises
+        a ``ValueError``: reassemble the message (e.g. via
+        ``MessageAssembler``) and decompress it as a whole.
+        """
+        if frame.rsv1 and frame.opcode in (OPCODES.TEXT, OPCODES.BINARY):
+            if not frame.fin:
+                raise ValueError("permessage-deflate operates on whole messages: reassemble before decoding")
+            return frame._replace(payload=self._ctx.decompress(frame.payload), rsv1=0)
+        return frame
+
+    @classmethod
+    def acquire(cls, level: int = -1, window_bits: int = 15) -> PermessageDeflate:
+        """Take an instance with these parameters from the pool or create
+        a new one.
+        """
+        try:
+            return cls._pools_[(level, window_bits)].popleft()
+        except (KeyError, IndexError):
+            return cls(level, window_bits)
+
+    @classmethod
+    def release(cls, instance: PermessageDeflate) -> None:
+        """Reset an instance and put it back into its parameter pool."""
+        instance.reset()
+        cls._pools_.setdefault((instance.level, instance.window_bits), deque()).append(instance)
+
+
 class FrameFactory:
 
     @staticmethod
@@ -510,14 +871,45 @@ class FrameFactory:
             fin = 1
         return Frame(message, opcode, mask, fin)
 
+    _PING_ENCODED_ = _wsframecoder.build(1, 0, 0, 0, OPCODES.PING, b"", b"")
+    _PONG_ENCODED_ = _wsframecoder.build(1, 0, 0, 0, OPCODES.PONG, b"", b"")
+    _CLOSE_ENCODED_: OrderedDict[tuple[int, bytes], bytes] = OrderedDict()
+    _CLOSE_ENCODED_MAX_ = 32
+
     @staticmethod
-    def PingFrame() -> Frame:
+    def PingFrame(encoded: bool = False) -> Frame | bytes:
+        """With `encoded=True` the pre-encoded streamdata singleton is
+        returned instead of a ``Frame``, skipping the per-heartbeat build.
+        """
+        if encoded:
+            return FrameFactory._PING_ENCODED_
         return Frame(b'', OPCODES.PING)
 
     @staticmethod
-    def PongFrame() -> Frame:
+    def PongFrame(encoded: bool = False) -> Frame | bytes:
+        """With `encoded=True` the pre-encoded streamdata singleton is
+        returned instead of a ``Frame``, skipping the per-heartbeat build.
+        """
+        if encoded:
+            return FrameFactory._PONG_ENCODED_
         return Frame(b'', OPCODES.PONG)
 
     @staticmethod
-    def CloseFrame(close_code: CloseCode, message_maximal123bytes: bytes = b"") -> Frame:
+    def CloseFrame(close_code: CloseCode, message_maximal123bytes: bytes = b"", encoded: bool = False) -> Frame | bytes:
+        """With `encoded=True` the streamdata is returned instead of a
+        ``Frame``, served from a small LRU keyed by close code and message.
+        """
+        if encoded:
+            cache = FrameFactory._CLOSE_ENCODED_
+            key = (int(close_code), bytes(message_maximal123bytes[:123]))
+            try:
+                cache.move_to_end(key)
+                return cache[key]
+            except KeyError:
+                pass
+            data = Frame(CloseCode(close_code).to_payload(message_maximal123bytes[:123]), OPCODES.CLOSE).to_streamdata()
+            cache[key] = data
+            if len(cache) > FrameFactory._CLOSE_ENCODED_MAX_:
+                cache.popitem(last=False)
+            return data
         return Frame(close_code.to_payload(message_maximal123bytes[:123]), OPCODES.CLOSE)
@@ -1,26 +1,200 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <structmember.h>
+#include <zlib.h>
+#include <sys/stat.h>
 
 #if __ARM_NEON
 #include <arm_neon.h>
 #elif __SSE2__
 #include <emmintrin.h>
+#if defined(__GNUC__)
+// wider kernels are compiled unconditionally via target attributes and
+// selected at module init based on what the host cpu supports
+#define MASKING_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
 #endif
 
 
-static char * _masking(char *input, Py_ssize_t len, char *mask) {
-    Py_ssize_t i = 0;
+// per-module (and thereby per-interpreter) state: the heap types, the
+// AUTO sentinel and the prng behind the AUTO mask mode of build
+typedef struct {
+    PyObject *StreamReaderType;
+    PyObject *DeflateContextType;
+    PyObject *MessageAssemblerType;
+    PyObject *MaskGeneratorType;
+    PyObject *RecvBufferType;
+    PyObject *FrameParserType;
+    PyObject *FrameType;
+    PyObject *PayloadTooLong;
+    PyObject *AutoMask;
+    uint32_t  auto_mask_prng[4];
+} wsframecoder_state;
 
-    char *output = (char*)malloc(len * sizeof(char));
-    if (output == NULL) {
+
+// raises the PayloadTooLong exception with the claimed size as second
+// exception argument, so callers can log or close without re-parsing
+// the message text
+static void _raise_payload_too_long(PyObject *exc, uint64_t amount, uint64_t limit) {
+    PyObject *msg = PyUnicode_FromFormat(
+        "invalid frame: claimed payload length (%llu) > max_payload_len (%llu)",
+        (unsigned long long)amount, (unsigned long long)limit
+    );
+    if (msg == NULL) {
+        return;
+    }
+    PyObject *claimed = PyLong_FromUnsignedLongLong(amount);
+    if (claimed == NULL) {
+        Py_DECREF(msg);
+        return;
+    }
+    PyObject *args = PyTuple_Pack(2, msg, claimed);
+    Py_DECREF(msg);
+    Py_DECREF(claimed);
+    if (args == NULL) {
+        return;
+    }
+    PyErr_SetObject(exc, args);
+    Py_DECREF(args);
+}
+
+
+// mask key generation: xoshiro128** seeded once from os.urandom.
+// RFC6455 asks for unpredictability towards the peer, not cryptographic
+// strength, so a fast user space prng replaces a syscall per frame.
+
+static inline uint32_t _rotl32(uint32_t x, int k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+
+static uint32_t _xoshiro128_next(uint32_t *s) {
+    uint32_t result = _rotl32(s[1] * 5, 7) * 9;
+    uint32_t t = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = _rotl32(s[3], 11);
+    return result;
+}
+
+
+static int _xoshiro128_seed(uint32_t *s) {
+    PyObject *os_mod = PyImport_ImportModule("os");
+    if (os_mod == NULL) {
+        return -1;
+    }
+    PyObject *seed = PyObject_CallMethod(os_mod, "urandom", "i", 16);
+    Py_DECREF(os_mod);
+    if (seed == NULL) {
+        return -1;
+    }
+    memcpy(s, PyBytes_AS_STRING(seed), 16);
+    Py_DECREF(seed);
+    if (!(s[0] | s[1] | s[2] | s[3])) {
+        // the all-zero state is the one invalid xoshiro state
+        s[0] = 1;
+    }
+    return 0;
+}
+
+
+// argument handling for the METH_FASTCALL entry points
+
+static int _check_nargs(const char *fname, Py_ssize_t nargs, Py_ssize_t min, Py_ssize_t max) {
+    if (nargs >= min && nargs <= max) {
+        return 0;
+    }
+    if (min == max) {
         PyErr_Format(
-            PyExc_SystemError,
-            "Memory allocation failed"
+            PyExc_TypeError,
+            "%s() takes exactly %zd arguments (%zd given)",
+            fname, min, nargs
         );
-        return NULL;
-    };
-    char *p_output = output;
-    
+    } else {
+        PyErr_Format(
+            PyExc_TypeError,
+            "%s() takes %zd to %zd arguments (%zd given)",
+            fname, min, max, nargs
+        );
+    }
+    return -1;
+}
+
+
+static int _as_int(PyObject *o, int *out) {
+    long v = PyLong_AsLong(o);
+    if (v == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+    *out = (int)v;
+    return 0;
+}
+
+
+static int _as_bool(PyObject *o, int *out) {
+    int v = PyObject_IsTrue(o);
+    if (v == -1) {
+        return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+
+static int _as_ssize(PyObject *o, Py_ssize_t *out) {
+    Py_ssize_t v = PyLong_AsSsize_t(o);
+    if (v == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+
+// payload sizes above this release the GIL around the masking kernels
+// and the large memcpy calls (the caller holds the buffer references,
+// so the memory stays valid while other threads run)
+#define NOGIL_THRESHOLD 8192
+
+
+// hot-path statistics: monotone counters maintained as plain per-call
+// increments (like the parallel masking config they are process-wide;
+// no synchronisation, so readings under heavy threading are
+// approximate). Scraped via get_stats, zeroed via reset_stats.
+static struct {
+    unsigned long long frames_parsed;
+    unsigned long long frames_built;
+    unsigned long long bytes_masked;
+    unsigned long long bytes_masked_vector;
+    unsigned long long bytes_masked_scalar;
+    unsigned long long alloc_failures;
+    unsigned long long calls_masking;
+    unsigned long long calls_masking_inplace;
+    unsigned long long calls_masking_offset;
+    unsigned long long calls_build;
+    unsigned long long calls_build_into;
+    unsigned long long calls_build_file_header;
+    unsigned long long calls_parse;
+    unsigned long long calls_parse_into;
+    unsigned long long calls_parse_all;
+    unsigned long long calls_parse_frame;
+    unsigned long long calls_parse_partial;
+    unsigned long long calls_stream_reader_feed;
+    unsigned long long calls_recv_buffer_read_frames;
+    unsigned long long calls_frame_parser_feed_data;
+} _stats;
+
+#define STATS_INC(field)    (_stats.field++)
+#define STATS_ADD(field, n) (_stats.field += (unsigned long long)(n))
+
+
+static void _masking_kernel_base(const char *input, char *output, Py_ssize_t len, char *mask) {
+    Py_ssize_t i = 0;
+
     {
 #if __ARM_NEON
         Py_ssize_t input_len_128 = len & ~15;
@@ -49,21 +223,290 @@ static char * _masking(char *input, Py_ssize_t len, char *mask) {
         }
 #endif
     }
-    
+
+    for (; i < len; i++) {
+        output[i] = input[i] ^ mask[i & 3];
+    }
+}
+
+
+#if MASKING_X86_DISPATCH
+__attribute__((target("avx2")))
+static void _masking_kernel_avx2(const char *input, char *output, Py_ssize_t len, char *mask) {
+    Py_ssize_t i = 0;
+
+    Py_ssize_t input_len_256 = len & ~31;
+    __m256i mask_256 = _mm256_set1_epi32(*(uint32_t *)mask);
+
+    for (; i < input_len_256; i += 32) {
+        __m256i in_256 = _mm256_loadu_si256((__m256i *)(input + i));
+        __m256i out_256 = _mm256_xor_si256(in_256, mask_256);
+        _mm256_storeu_si256((__m256i *)(output + i), out_256);
+    }
+
+    for (; i < len; i++) {
+        output[i] = input[i] ^ mask[i & 3];
+    }
+}
+
+
+__attribute__((target("avx512f")))
+static void _masking_kernel_avx512(const char *input, char *output, Py_ssize_t len, char *mask) {
+    Py_ssize_t i = 0;
+
+    Py_ssize_t input_len_512 = len & ~63;
+    __m512i mask_512 = _mm512_set1_epi32(*(uint32_t *)mask);
+
+    for (; i < input_len_512; i += 64) {
+        __m512i in_512 = _mm512_loadu_si512((void *)(input + i));
+        __m512i out_512 = _mm512_xor_si512(in_512, mask_512);
+        _mm512_storeu_si512((void *)(output + i), out_512);
+    }
+
     for (; i < len; i++) {
         output[i] = input[i] ^ mask[i & 3];
     }
-    return p_output;
 }
+#endif
+
+
+// resolved once in PyInit__wsframecoder to the widest kernel the host supports
+static void (*_masking_kernel)(const char *, char *, Py_ssize_t, char *) = _masking_kernel_base;
+
+
+// parallel masking: opt-in via set_parallel_masking. One kernel pass is
+// memory-bandwidth-bound on a single core, so very large payloads are
+// split across worker threads. The slices are multiples of 64 bytes
+// (cache line and a multiple of 4), so every worker starts at mask
+// offset 0 and no key rotation is needed. Threads are spawned per call:
+// against the multi-megabyte threshold the spawn cost is noise and no
+// pool has to survive fork or interpreter shutdown.
+
+#ifndef _WIN32
+#include <pthread.h>
+#define MASKING_PARALLEL 1
+#endif
+
+#define MASKING_MAX_WORKERS 16
+
+static int        _parallel_workers = 0;
+static Py_ssize_t _parallel_threshold = 4 * 1024 * 1024;
+
+#if MASKING_PARALLEL
+
+typedef struct {
+    const char *input;
+    char       *output;
+    Py_ssize_t  len;
+    char        mask[4];
+} _masking_job;
+
+
+static void * _masking_job_run(void *arg) {
+    _masking_job *job = (_masking_job *)arg;
+    _masking_kernel(job->input, job->output, job->len, job->mask);
+    return NULL;
+}
+
+
+static void _masking_kernel_mt(const char *input, char *output, Py_ssize_t len, char *mask, int workers) {
+    pthread_t    threads[MASKING_MAX_WORKERS];
+    _masking_job jobs[MASKING_MAX_WORKERS];
+
+    Py_ssize_t chunk = (len / workers) & ~(Py_ssize_t)63;
+    Py_ssize_t offset = 0;
+    int started = 0;
+
+    if (chunk) {
+        for (int i = 0; i < workers - 1; i++) {
+            jobs[i].input = input + offset;
+            jobs[i].output = output + offset;
+            jobs[i].len = chunk;
+            memcpy(jobs[i].mask, mask, 4);
+            if (pthread_create(&threads[i], NULL, _masking_job_run, &jobs[i]) != 0) {
+                // degrade gracefully: the tail pass below covers the rest
+                break;
+            }
+            started++;
+            offset += chunk;
+        }
+    }
+
+    _masking_kernel(input + offset, output + offset, len - offset, mask);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+#endif
+
+
+// single kernel pass or the parallel split, depending on configuration
+static void _masking_run(const char *input, char *output, Py_ssize_t len, char *mask) {
+    // vector vs scalar split of the resolved kernel; the parallel path
+    // slices at 64-byte boundaries, so the formula stays exact there
+    Py_ssize_t width;
+#if MASKING_X86_DISPATCH
+    if (_masking_kernel == _masking_kernel_avx512) {
+        width = 64;
+    } else if (_masking_kernel == _masking_kernel_avx2) {
+        width = 32;
+    } else {
+        width = 16;
+    }
+#elif __ARM_NEON || __SSE2__
+    width = 16;
+#else
+    width = 8;
+#endif
+    STATS_ADD(bytes_masked, len);
+    STATS_ADD(bytes_masked_vector, len & ~(width - 1));
+    STATS_ADD(bytes_masked_scalar, len & (width - 1));
+#if MASKING_PARALLEL
+    // snapshot the config: we may run without the gil here and another
+    // thread can call set_parallel_masking concurrently
+    int workers = _parallel_workers;
+    if (workers >= 2 && len >= _parallel_threshold) {
+        _masking_kernel_mt(input, output, len, mask, workers);
+        return;
+    }
+#endif
+    _masking_kernel(input, output, len, mask);
+}
+
+
+static char * _masking(char *input, Py_ssize_t len, char *mask) {
+    char *output = (char*)malloc(len * sizeof(char));
+    if (output == NULL) {
+        STATS_INC(alloc_failures);
+        PyErr_Format(
+            PyExc_SystemError,
+            "Memory allocation failed"
+        );
+        return NULL;
+    };
+
+    if (len >= NOGIL_THRESHOLD) {
+        Py_BEGIN_ALLOW_THREADS
+        _masking_run(input, output, len, mask);
+        Py_END_ALLOW_THREADS
+    } else {
+        _masking_run(input, output, len, mask);
+    }
+    return output;
+}
+
+
+static void _masking_inplace(char *buffer, Py_ssize_t len, char *mask) {
+    if (len >= NOGIL_THRESHOLD) {
+        Py_BEGIN_ALLOW_THREADS
+        _masking_run(buffer, buffer, len, mask);
+        Py_END_ALLOW_THREADS
+    } else {
+        _masking_run(buffer, buffer, len, mask);
+    }
+}
+
+
+// utf-8 validation: Hoehrmann style shift dfa for the multi-byte
+// sequences, with a vectorized fast path skipping pure ascii blocks
+#define UTF8_ACCEPT 0
+#define UTF8_REJECT 12
+
+static const uint8_t _utf8_dfa[] = {
+    // character class per byte
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,
+    7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7, 7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+    8,8,2,2,2,2,2,2,2,2,2,2,2,2,2,2, 2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+    10,3,3,3,3,3,3,3,3,3,3,3,3,4,3,3, 11,6,6,6,5,8,8,8,8,8,8,8,8,8,8,8,
+    // transition table
+    0,12,24,36,60,96,84,12,12,12,48,72, 12,12,12,12,12,12,12,12,12,12,12,12,
+    12, 0,12,12,12,12,12, 0,12, 0,12,12, 12,24,12,12,12,12,12,24,12,24,12,12,
+    12,12,12,12,12,12,12,24,12,12,12,12, 12,24,12,12,12,12,12,12,12,24,12,12,
+    12,12,12,12,12,12,12,36,12,36,12,12, 12,36,12,12,12,12,12,36,12,36,12,12,
+    12,36,12,12,12,12,12,12,12,12,12,12,
+};
+
+
+static int _validate_utf8(const char *input, Py_ssize_t len) {
+    uint32_t state = UTF8_ACCEPT;
+    Py_ssize_t i = 0;
+
+    while (i < len) {
+        if (state == UTF8_ACCEPT) {
+#if __ARM_NEON
+            while (i + 16 <= len) {
+                uint8x16_t in_128 = vld1q_u8((uint8_t *)(input + i));
+                uint64x2_t high_64 = vreinterpretq_u64_u8(vandq_u8(in_128, vdupq_n_u8(0x80)));
+                if (vgetq_lane_u64(high_64, 0) | vgetq_lane_u64(high_64, 1)) {
+                    break;
+                }
+                i += 16;
+            }
+#elif __SSE2__
+            while (i + 16 <= len) {
+                __m128i in_128 = _mm_loadu_si128((__m128i *)(input + i));
+                if (_mm_movemask_epi8(in_128)) {
+                    break;
+                }
+                i += 16;
+            }
+#endif
+            while (i < len && !(input[i] & 0x80)) {
+                i++;
+            }
+            if (i == len) {
+                break;
+            }
+        }
+        state = _utf8_dfa[256 + state + _utf8_dfa[(uint8_t)input[i]]];
+        if (state == UTF8_REJECT) {
+            return 0;
+        }
+        i++;
+    }
+    return state == UTF8_ACCEPT;
+}
+
+
+static PyObject * validate_utf8(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (_check_nargs("validate_utf8", nargs, 1, 1) == -1) {
+        return NULL;
+    }
+    Py_buffer i_buffer;
+
+    if (PyObject_GetBuffer(args[0], &i_buffer, PyBUF_SIMPLE) == -1) {
+        return NULL;
+    }
 
+    int valid;
+    if (i_buffer.len >= NOGIL_THRESHOLD) {
+        char       *_data = (char *)i_buffer.buf;
+        Py_ssize_t  _len = i_buffer.len;
+        Py_BEGIN_ALLOW_THREADS
+        valid = _validate_utf8(_data, _len);
+        Py_END_ALLOW_THREADS
+    } else {
+        valid = _validate_utf8((char *)i_buffer.buf, i_buffer.len);
+    }
+
+    PyBuffer_Release(&i_buffer);
+    return PyBool_FromLong(valid);
+}
 
-static PyObject * masking(PyObject *self, PyObject *args) {
-    PyObject  *i_payload;
-    PyObject  *i_mask;
 
-    if (!PyArg_ParseTuple(args, "OO", &i_payload, &i_mask)) {
+static PyObject * masking(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    STATS_INC(calls_masking);
+    if (_check_nargs("masking", nargs, 2, 2) == -1) {
         return NULL;
     }
+    PyObject  *i_payload = args[0];
+    PyObject  *i_mask = args[1];
 
     char       *mask;
     Py_ssize_t  mask_len;
@@ -97,429 +540,4113 @@ static PyObject * masking(PyObject *self, PyObject *args) {
 }
 
 
-static PyObject * build(PyObject *self, PyObject *args) {
-    uint8_t  i_fin;
-    uint8_t  i_rsv1;
-    uint8_t  i_rsv2;
-    uint8_t  i_rsv3;
-    uint8_t  i_opcode;
-    PyObject *i_mask = NULL;
-    PyObject *i_payload = NULL;
-
-    if (!PyArg_ParseTuple(args, "ppppiOO", &i_fin, &i_rsv1, &i_rsv2, &i_rsv3, &i_opcode, &i_mask, &i_payload)) {
+static PyObject * set_parallel_masking(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (_check_nargs("set_parallel_masking", nargs, 1, 2) == -1) {
         return NULL;
     }
-    
-    char       *mask;
-    Py_ssize_t  mask_len;
+    int        i_workers;
+    Py_ssize_t i_threshold = 4 * 1024 * 1024;
 
-    if (PyBytes_AsStringAndSize(i_mask, &mask, &mask_len) == -1) {
+    if (_as_int(args[0], &i_workers) == -1
+        || (nargs == 2 && _as_ssize(args[1], &i_threshold) == -1)) {
         return NULL;
     }
-
-    uint8_t masked;
-    if (mask_len == 4) {
-        masked = 0b10000000;
-    } else if (mask_len == 0) {
-        masked = 0b00000000;
-    } else {
+    if (i_workers < 0 || i_workers > MASKING_MAX_WORKERS) {
         PyErr_Format(
             PyExc_ValueError,
-            "invalid mask: length != 4"
+            "invalid workers: not in [0, %d]",
+            MASKING_MAX_WORKERS
         );
         return NULL;
     }
-
-    char       *payload;
-    Py_ssize_t  amount;
-    
-    if (PyBytes_AsStringAndSize(i_payload, &payload, &amount) == -1) {
-        return NULL;
-    }
-    
-    int header_offset = 2;
-    
-    uint8_t amount_spec;
-    int _amount_spec_len;
-    if (amount <= 125) {
-        amount_spec = amount;
-        _amount_spec_len = 0;
-    } else if (amount <= 65535) {
-        amount_spec = 0b01111110;
-        _amount_spec_len = 2;
-    } else {
-        amount_spec = 0b01111111;
-        _amount_spec_len = 8;
-    }
-    
-    int total_amount = header_offset + _amount_spec_len + mask_len + amount;
-    PyObject *o_obj = PyBytes_FromStringAndSize(NULL, total_amount);
-    if (o_obj == NULL) {
+    if (i_threshold < 1) {
         PyErr_Format(
-            PyExc_SystemError,
-            "could not create PyBytes"
+            PyExc_ValueError,
+            "invalid threshold: < 1"
         );
         return NULL;
-    };
-    char *o_obj_data = PyBytes_AS_STRING(o_obj);
-    
-    if (i_fin) {
-        i_fin = 0b10000000;
     }
-    if (i_rsv1) {
-        i_rsv1 = 0b01000000;
+#if !MASKING_PARALLEL
+    // no thread support on this platform: stay on the single kernel pass
+    i_workers = 0;
+#endif
+    _parallel_workers = i_workers;
+    _parallel_threshold = i_threshold;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject * masking_backend(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (_check_nargs("masking_backend", nargs, 0, 0) == -1) {
+        return NULL;
     }
-    if (i_rsv2) {
-        i_rsv2 = 0b00100000;
+#if MASKING_X86_DISPATCH
+    if (_masking_kernel == _masking_kernel_avx512) {
+        return PyUnicode_FromString("avx512f");
     }
-    if (i_rsv3) {
-        i_rsv3 = 0b00010000;
+    if (_masking_kernel == _masking_kernel_avx2) {
+        return PyUnicode_FromString("avx2");
     }
+#endif
+#if __ARM_NEON
+    return PyUnicode_FromString("neon");
+#elif __SSE2__
+    return PyUnicode_FromString("sse2");
+#else
+    return PyUnicode_FromString("scalar64");
+#endif
+}
 
-    o_obj_data[0] = i_fin|i_rsv1|i_rsv2|i_rsv3|i_opcode;
-    o_obj_data[1] = masked | amount_spec;
-    
-    if (_amount_spec_len == 2) {
-        o_obj_data[2] = (amount >> 8)  & 0b11111111;
-        o_obj_data[3] =  amount        & 0b11111111;
-    } else if (_amount_spec_len == 8) {
-        o_obj_data[2] = (amount >> 56) & 0b11111111;
-        o_obj_data[3] = (amount >> 48) & 0b11111111;
-        o_obj_data[4] = (amount >> 40) & 0b11111111;
-        o_obj_data[5] = (amount >> 32) & 0b11111111;
-        o_obj_data[6] = (amount >> 24) & 0b11111111;
-        o_obj_data[7] = (amount >> 16) & 0b11111111;
-        o_obj_data[8] = (amount >> 8)  & 0b11111111;
-        o_obj_data[9] =  amount        & 0b11111111;
-    }
 
-    header_offset += _amount_spec_len;
-    
-    if (masked) {
-        memcpy(o_obj_data + header_offset, mask, 4);
-        header_offset += 4;
-        char *masked_payload = _masking(payload, amount, mask);
-        if (masked_payload == NULL) {
-            PyObject_Del(o_obj);
-            return NULL;
-        }
-        memcpy(o_obj_data + header_offset, masked_payload, amount);
-        free(masked_payload);
-    } else {
-        memcpy(o_obj_data + header_offset, payload, amount);
+static PyObject * get_stats(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (_check_nargs("get_stats", nargs, 0, 0) == -1) {
+        return NULL;
     }
-
-    return o_obj;
+    return Py_BuildValue(
+        "{s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K}",
+        "frames_parsed", _stats.frames_parsed,
+        "frames_built", _stats.frames_built,
+        "bytes_masked", _stats.bytes_masked,
+        "bytes_masked_vector", _stats.bytes_masked_vector,
+        "bytes_masked_scalar", _stats.bytes_masked_scalar,
+        "alloc_failures", _stats.alloc_failures,
+        "calls_masking", _stats.calls_masking,
+        "calls_masking_inplace", _stats.calls_masking_inplace,
+        "calls_masking_offset", _stats.calls_masking_offset,
+        "calls_build", _stats.calls_build,
+        "calls_build_into", _stats.calls_build_into,
+        "calls_build_file_header", _stats.calls_build_file_header,
+        "calls_parse", _stats.calls_parse,
+        "calls_parse_into", _stats.calls_parse_into,
+        "calls_parse_all", _stats.calls_parse_all,
+        "calls_parse_frame", _stats.calls_parse_frame,
+        "calls_parse_partial", _stats.calls_parse_partial,
+        "calls_stream_reader_feed", _stats.calls_stream_reader_feed,
+        "calls_recv_buffer_read_frames", _stats.calls_recv_buffer_read_frames,
+        "calls_frame_parser_feed_data", _stats.calls_frame_parser_feed_data
+    );
 }
 
-static PyObject * parse(PyObject *self, PyObject *args) {
-    PyObject   *i_obj;
-    Py_ssize_t  i_len;
-    char       *i_data;
-    int         i_autodemask;
 
-    char     *o_mask = NULL;
-    char     *o_masked_payload = NULL;
-    PyObject *o_obj = NULL;
-    
-    if (!PyArg_ParseTuple(args, "Op", &i_obj, &i_autodemask))
-    {
-        goto exit;
+static PyObject * reset_stats(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (_check_nargs("reset_stats", nargs, 0, 0) == -1) {
+        return NULL;
     }
+    memset(&_stats, 0, sizeof(_stats));
+    Py_RETURN_NONE;
+}
 
-    if (PyBytes_AsStringAndSize(i_obj, &i_data, &i_len) == -1) {
-        goto exit;
+
+static PyObject * masking_offset(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    STATS_INC(calls_masking_offset);
+    if (_check_nargs("masking_offset", nargs, 3, 3) == -1) {
+        return NULL;
     }
+    PyObject  *i_payload = args[0];
+    PyObject  *i_mask = args[1];
+    Py_ssize_t i_start_offset;
 
-    uint64_t _header_offset = 2;
-    
-    if ((uint64_t)i_len < _header_offset) {
+    if (_as_ssize(args[2], &i_start_offset) == -1) {
+        return NULL;
+    }
+    if (i_start_offset < 0) {
         PyErr_Format(
             PyExc_ValueError,
-            "invalid frame: data length < 2"
+            "invalid start_offset: < 0"
         );
-        goto exit;
+        return NULL;
     }
 
-    unsigned char *_input = (unsigned char *)i_data;
+    char       *mask;
+    Py_ssize_t  mask_len;
 
-    char _b1 = _input[0];
-    int      fin         = (_b1 & 0b10000000) >> 7;
-    int      rsv1        = (_b1 & 0b01000000) >> 6;
-    int      rsv2        = (_b1 & 0b00100000) >> 5;
-    int      rsv3        = (_b1 & 0b00010000) >> 4;
-    int      opcode      = (_b1 & 0b00001111);
-    char _b2 = _input[1];
-    int      masked      = (_b2 & 0b10000000) >> 7;
-    int      amount_spec = (_b2 & 0b01111111);
-    uint64_t amount;
-    
-    if (amount_spec == 126) {
-        amount =  (uint64_t)_input[2];
-        amount <<= 8;
-        amount |= (uint64_t)_input[3];
-        _header_offset += 2;
-    } else if (amount_spec == 127) {
-        amount =  (uint64_t)_input[2];
-        amount <<= 8;
-        amount |= (uint64_t)_input[3];
-        amount <<= 8;
-        amount |= (uint64_t)_input[4];
-        amount <<= 8;
-        amount |= (uint64_t)_input[5];
-        amount <<= 8;
-        amount |= (uint64_t)_input[6];
-        amount <<= 8;
-        amount |= (uint64_t)_input[7];
-        amount <<= 8;
-        amount |= (uint64_t)_input[8];
-        amount <<= 8;
-        amount |= (uint64_t)_input[9];
-        _header_offset += 8;
+    if (PyBytes_AsStringAndSize(i_mask, &mask, &mask_len) == -1) {
+        return NULL;
+    }
+
+    if (mask_len != 4) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid mask: length != 4"
+        );
+        return NULL;
+    }
+
+    char       *payload;
+    Py_ssize_t  payload_len;
+
+    if (PyBytes_AsStringAndSize(i_payload, &payload, &payload_len) == -1) {
+        return NULL;
+    }
+
+    // pre-rotating the key keeps the SIMD paths: a mask rotated by
+    // (start_offset % 4) applied from 0 equals the original applied
+    // from start_offset
+    char rotated[4];
+    rotated[0] = mask[(i_start_offset + 0) & 3];
+    rotated[1] = mask[(i_start_offset + 1) & 3];
+    rotated[2] = mask[(i_start_offset + 2) & 3];
+    rotated[3] = mask[(i_start_offset + 3) & 3];
+
+    char *o_obj_data = _masking(payload, payload_len, rotated);
+    if (o_obj_data == NULL) {
+        return NULL;
+    }
+    PyObject *o_obj = PyBytes_FromStringAndSize(o_obj_data, payload_len);
+    free(o_obj_data);
+    return o_obj;
+}
+
+
+static PyObject * masking_inplace(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    STATS_INC(calls_masking_inplace);
+    if (_check_nargs("masking_inplace", nargs, 2, 2) == -1) {
+        return NULL;
+    }
+    Py_buffer  i_buffer;
+    PyObject  *i_mask = args[1];
+
+    if (PyObject_GetBuffer(args[0], &i_buffer, PyBUF_WRITABLE) == -1) {
+        return NULL;
+    }
+
+    char       *mask;
+    Py_ssize_t  mask_len;
+
+    if (PyBytes_AsStringAndSize(i_mask, &mask, &mask_len) == -1) {
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+
+    if (mask_len != 4) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid mask: length != 4"
+        );
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+
+    _masking_inplace((char *)i_buffer.buf, i_buffer.len, mask);
+
+    PyBuffer_Release(&i_buffer);
+    Py_RETURN_NONE;
+}
+
+
+// writes the 2-14 byte frame header into o_data and returns its length
+static int _build_header(
+    char *o_data,
+    uint8_t fin, uint8_t rsv1, uint8_t rsv2, uint8_t rsv3, uint8_t opcode,
+    char *mask, Py_ssize_t mask_len, Py_ssize_t amount
+) {
+    uint8_t masked = mask_len ? 0b10000000 : 0b00000000;
+
+    int header_offset = 2;
+
+    uint8_t amount_spec;
+    int _amount_spec_len;
+    if (amount <= 125) {
+        amount_spec = amount;
+        _amount_spec_len = 0;
+    } else if (amount <= 65535) {
+        amount_spec = 0b01111110;
+        _amount_spec_len = 2;
     } else {
-        amount = amount_spec;
+        amount_spec = 0b01111111;
+        _amount_spec_len = 8;
+    }
+
+    if (fin) {
+        fin = 0b10000000;
+    }
+    if (rsv1) {
+        rsv1 = 0b01000000;
+    }
+    if (rsv2) {
+        rsv2 = 0b00100000;
+    }
+    if (rsv3) {
+        rsv3 = 0b00010000;
+    }
+
+    o_data[0] = fin|rsv1|rsv2|rsv3|opcode;
+    o_data[1] = masked | amount_spec;
+
+    if (_amount_spec_len == 2) {
+        o_data[2] = (amount >> 8)  & 0b11111111;
+        o_data[3] =  amount        & 0b11111111;
+    } else if (_amount_spec_len == 8) {
+        o_data[2] = (amount >> 56) & 0b11111111;
+        o_data[3] = (amount >> 48) & 0b11111111;
+        o_data[4] = (amount >> 40) & 0b11111111;
+        o_data[5] = (amount >> 32) & 0b11111111;
+        o_data[6] = (amount >> 24) & 0b11111111;
+        o_data[7] = (amount >> 16) & 0b11111111;
+        o_data[8] = (amount >> 8)  & 0b11111111;
+        o_data[9] =  amount        & 0b11111111;
+    }
+
+    header_offset += _amount_spec_len;
+
+    if (masked) {
+        memcpy(o_data + header_offset, mask, 4);
+        header_offset += 4;
+    }
+
+    STATS_INC(frames_built);
+    return header_offset;
+}
+
+
+static PyObject * build_header(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (_check_nargs("build_header", nargs, 7, 7) == -1) {
+        return NULL;
+    }
+    int      i_fin;
+    int      i_rsv1;
+    int      i_rsv2;
+    int      i_rsv3;
+    int      i_opcode;
+    PyObject *i_mask = args[5];
+    Py_ssize_t i_payload_len;
+
+    if (_as_bool(args[0], &i_fin) == -1
+        || _as_bool(args[1], &i_rsv1) == -1
+        || _as_bool(args[2], &i_rsv2) == -1
+        || _as_bool(args[3], &i_rsv3) == -1
+        || _as_int(args[4], &i_opcode) == -1
+        || _as_ssize(args[6], &i_payload_len) == -1) {
+        return NULL;
+    }
+
+    char       *mask;
+    Py_ssize_t  mask_len;
+
+    if (PyBytes_AsStringAndSize(i_mask, &mask, &mask_len) == -1) {
+        return NULL;
+    }
+
+    if (mask_len != 4 && mask_len != 0) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid mask: length != 4"
+        );
+        return NULL;
+    }
+
+    char header[14];
+    int header_len = _build_header(header, i_fin, i_rsv1, i_rsv2, i_rsv3, i_opcode, mask, mask_len, i_payload_len);
+
+    return PyBytes_FromStringAndSize(header, header_len);
+}
+
+
+static PyObject * build_file_header(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    STATS_INC(calls_build_file_header);
+    if (_check_nargs("build_file_header", nargs, 3, 5) == -1) {
+        return NULL;
+    }
+    PyObject   *i_fd_or_path = args[0];
+    Py_ssize_t  i_offset;
+    Py_ssize_t  i_length;
+    int         i_opcode = 0b00000010;
+    int         i_fin = 1;
+
+    if (_as_ssize(args[1], &i_offset) == -1
+        || _as_ssize(args[2], &i_length) == -1
+        || (nargs >= 4 && _as_int(args[3], &i_opcode) == -1)
+        || (nargs >= 5 && _as_bool(args[4], &i_fin) == -1)) {
+        return NULL;
+    }
+    if (i_offset < 0 || i_length < 0) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid region: offset or length < 0"
+        );
+        return NULL;
+    }
+
+    struct stat st;
+
+    if (PyLong_Check(i_fd_or_path)) {
+        int fd = (int)PyLong_AsLong(i_fd_or_path);
+        if (fd == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+        if (fstat(fd, &st) != 0) {
+            return PyErr_SetFromErrno(PyExc_OSError);
+        }
+    } else {
+        PyObject *path = NULL;
+        if (!PyUnicode_FSConverter(i_fd_or_path, &path)) {
+            return NULL;
+        }
+        int err = stat(PyBytes_AS_STRING(path), &st);
+        if (err != 0) {
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, i_fd_or_path);
+            Py_DECREF(path);
+            return NULL;
+        }
+        Py_DECREF(path);
+    }
+
+    if (!S_ISREG(st.st_mode)) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid region: not a regular file"
+        );
+        return NULL;
+    }
+    if ((uint64_t)i_offset + (uint64_t)i_length > (uint64_t)st.st_size) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid region: offset (%zd) + length (%zd) > file size (%lld)",
+            i_offset, i_length, (long long)st.st_size
+        );
+        return NULL;
+    }
+
+    // server-to-client frames are unmasked, which is what makes sending
+    // the body straight from the page cache via os.sendfile legal
+    char header[14];
+    int header_len = _build_header(header, i_fin, 0, 0, 0, i_opcode, NULL, 0, i_length);
+
+    return PyBytes_FromStringAndSize(header, header_len);
+}
+
+
+static PyObject * build(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    STATS_INC(calls_build);
+    if (_check_nargs("build", nargs, 7, 8) == -1) {
+        return NULL;
+    }
+    int      i_fin;
+    int      i_rsv1;
+    int      i_rsv2;
+    int      i_rsv3;
+    int      i_opcode;
+    PyObject *i_mask = args[5];
+    PyObject *i_payload = args[6];
+    int      i_validate_utf8 = 0;
+
+    if (_as_bool(args[0], &i_fin) == -1
+        || _as_bool(args[1], &i_rsv1) == -1
+        || _as_bool(args[2], &i_rsv2) == -1
+        || _as_bool(args[3], &i_rsv3) == -1
+        || _as_int(args[4], &i_opcode) == -1
+        || (nargs == 8 && _as_bool(args[7], &i_validate_utf8) == -1)) {
+        return NULL;
+    }
+
+    char       *mask;
+    Py_ssize_t  mask_len;
+    char        auto_mask[4];
+
+    wsframecoder_state *state = (wsframecoder_state *)PyModule_GetState(self);
+
+    if (i_mask == state->AutoMask) {
+        uint32_t key = _xoshiro128_next(state->auto_mask_prng);
+        memcpy(auto_mask, &key, 4);
+        mask = auto_mask;
+        mask_len = 4;
+    } else if (PyBytes_AsStringAndSize(i_mask, &mask, &mask_len) == -1) {
+        return NULL;
+    }
+
+    if (mask_len != 4 && mask_len != 0) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid mask: length != 4"
+        );
+        return NULL;
+    }
+
+    char       *payload;
+    Py_ssize_t  amount;
+
+    if (PyBytes_AsStringAndSize(i_payload, &payload, &amount) == -1) {
+        return NULL;
+    }
+
+    if (i_validate_utf8 && i_opcode == 0b00000001 && i_fin) {
+        int valid;
+        if (amount >= NOGIL_THRESHOLD) {
+            Py_BEGIN_ALLOW_THREADS
+            valid = _validate_utf8(payload, amount);
+            Py_END_ALLOW_THREADS
+        } else {
+            valid = _validate_utf8(payload, amount);
+        }
+        if (!valid) {
+            PyErr_Format(
+                PyExc_ValueError,
+                "invalid frame: payload is not valid utf-8"
+            );
+            return NULL;
+        }
+    }
+
+    char header[14];
+    int header_offset = _build_header(header, i_fin, i_rsv1, i_rsv2, i_rsv3, i_opcode, mask, mask_len, amount);
+
+    PyObject *o_obj = PyBytes_FromStringAndSize(NULL, header_offset + amount);
+    if (o_obj == NULL) {
+        PyErr_Format(
+            PyExc_SystemError,
+            "could not create PyBytes"
+        );
+        return NULL;
+    };
+    char *o_obj_data = PyBytes_AS_STRING(o_obj);
+
+    memcpy(o_obj_data, header, header_offset);
+
+    // masking writes straight into the output buffer, so the masked and
+    // the unmasked branch both touch the payload bytes exactly once
+    if (amount >= NOGIL_THRESHOLD) {
+        Py_BEGIN_ALLOW_THREADS
+        if (mask_len) {
+            _masking_run(payload, o_obj_data + header_offset, amount, mask);
+        } else {
+            memcpy(o_obj_data + header_offset, payload, amount);
+        }
+        Py_END_ALLOW_THREADS
+    } else {
+        if (mask_len) {
+            _masking_run(payload, o_obj_data + header_offset, amount, mask);
+        } else {
+            memcpy(o_obj_data + header_offset, payload, amount);
+        }
+    }
+
+    return o_obj;
+}
+
+typedef struct {
+    uint8_t     fin;
+    uint8_t     rsv1;
+    uint8_t     rsv2;
+    uint8_t     rsv3;
+    uint8_t     opcode;
+    char       *mask;
+    Py_ssize_t  mask_len;
+    char       *payload;
+    Py_ssize_t  amount;
+} _frame_spec;
+
+
+// validates a sequence of (fin, rsv1, rsv2, rsv3, opcode, mask, payload)
+// tuples into *o_specs (malloc'd, caller frees) and returns the total
+// encoded size, -1 on error
+static Py_ssize_t _collect_frame_specs(PyObject *i_seq, _frame_spec **o_specs, Py_ssize_t *o_count) {
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(i_seq);
+    _frame_spec *specs = (_frame_spec*)malloc((n ? n : 1) * sizeof(_frame_spec));
+    if (specs == NULL) {
+        STATS_INC(alloc_failures);
+        PyErr_Format(
+            PyExc_SystemError,
+            "Memory allocation failed"
+        );
+        return -1;
+    }
+
+    Py_ssize_t total = 0;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(i_seq, i);
+        _frame_spec *spec = specs + i;
+        PyObject *i_mask;
+        PyObject *i_payload;
+        if (!PyTuple_Check(item) || !PyArg_ParseTuple(
+            item, "ppppiOO",
+            &spec->fin, &spec->rsv1, &spec->rsv2, &spec->rsv3, &spec->opcode, &i_mask, &i_payload
+        )) {
+            goto fail;
+        }
+        if (PyBytes_AsStringAndSize(i_mask, &spec->mask, &spec->mask_len) == -1) {
+            goto fail;
+        }
+        if (spec->mask_len != 4 && spec->mask_len != 0) {
+            PyErr_Format(
+                PyExc_ValueError,
+                "invalid mask: length != 4"
+            );
+            goto fail;
+        }
+        if (PyBytes_AsStringAndSize(i_payload, &spec->payload, &spec->amount) == -1) {
+            goto fail;
+        }
+        total += 2 + (spec->amount <= 125 ? 0 : spec->amount <= 65535 ? 2 : 8) + spec->mask_len + spec->amount;
+    }
+
+    *o_specs = specs;
+    *o_count = n;
+    return total;
+
+fail:
+    free(specs);
+    return -1;
+}
+
+
+static void _write_frame_specs(_frame_spec *specs, Py_ssize_t count, char *o_data) {
+    for (Py_ssize_t i = 0; i < count; i++) {
+        _frame_spec *spec = specs + i;
+        o_data += _build_header(
+            o_data,
+            spec->fin, spec->rsv1, spec->rsv2, spec->rsv3, spec->opcode,
+            spec->mask, spec->mask_len, spec->amount
+        );
+        if (spec->mask_len) {
+            _masking_run(spec->payload, o_data, spec->amount, spec->mask);
+        } else {
+            memcpy(o_data, spec->payload, spec->amount);
+        }
+        o_data += spec->amount;
+    }
+}
+
+
+static PyObject * build_many(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (_check_nargs("build_many", nargs, 1, 1) == -1) {
+        return NULL;
+    }
+
+    PyObject *i_seq = PySequence_Fast(args[0], "frames must be a sequence of tuples");
+    if (i_seq == NULL) {
+        return NULL;
+    }
+
+    _frame_spec *specs = NULL;
+    Py_ssize_t   count = 0;
+    Py_ssize_t   total = _collect_frame_specs(i_seq, &specs, &count);
+    if (total == -1) {
+        Py_DECREF(i_seq);
+        return NULL;
+    }
+
+    PyObject *o_obj = PyBytes_FromStringAndSize(NULL, total);
+    if (o_obj == NULL) {
+        PyErr_Format(
+            PyExc_SystemError,
+            "could not create PyBytes"
+        );
+        free(specs);
+        Py_DECREF(i_seq);
+        return NULL;
+    };
+
+    char *o_obj_data = PyBytes_AS_STRING(o_obj);
+    if (total >= NOGIL_THRESHOLD) {
+        Py_BEGIN_ALLOW_THREADS
+        _write_frame_specs(specs, count, o_obj_data);
+        Py_END_ALLOW_THREADS
+    } else {
+        _write_frame_specs(specs, count, o_obj_data);
+    }
+
+    free(specs);
+    Py_DECREF(i_seq);
+    return o_obj;
+}
+
+
+static PyObject * build_many_into(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (_check_nargs("build_many_into", nargs, 2, 2) == -1) {
+        return NULL;
+    }
+    Py_buffer  i_buffer;
+
+    if (PyObject_GetBuffer(args[1], &i_buffer, PyBUF_WRITABLE) == -1) {
+        return NULL;
+    }
+
+    PyObject *i_seq = PySequence_Fast(args[0], "frames must be a sequence of tuples");
+    if (i_seq == NULL) {
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+
+    _frame_spec *specs = NULL;
+    Py_ssize_t   count = 0;
+    Py_ssize_t   total = _collect_frame_specs(i_seq, &specs, &count);
+    if (total == -1) {
+        Py_DECREF(i_seq);
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+
+    if (total > i_buffer.len) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid buffer: length (%zd) < encoded size (%zd)",
+            i_buffer.len, total
+        );
+        free(specs);
+        Py_DECREF(i_seq);
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+
+    char *o_data = (char *)i_buffer.buf;
+    if (total >= NOGIL_THRESHOLD) {
+        Py_BEGIN_ALLOW_THREADS
+        _write_frame_specs(specs, count, o_data);
+        Py_END_ALLOW_THREADS
+    } else {
+        _write_frame_specs(specs, count, o_data);
+    }
+
+    free(specs);
+    Py_DECREF(i_seq);
+    PyBuffer_Release(&i_buffer);
+    return PyLong_FromSsize_t(total);
+}
+
+
+static PyObject * build_into(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    STATS_INC(calls_build_into);
+    if (_check_nargs("build_into", nargs, 8, 8) == -1) {
+        return NULL;
+    }
+    int      i_fin;
+    int      i_rsv1;
+    int      i_rsv2;
+    int      i_rsv3;
+    int      i_opcode;
+    PyObject *i_mask = args[5];
+    PyObject *i_payload = args[6];
+
+    if (_as_bool(args[0], &i_fin) == -1
+        || _as_bool(args[1], &i_rsv1) == -1
+        || _as_bool(args[2], &i_rsv2) == -1
+        || _as_bool(args[3], &i_rsv3) == -1
+        || _as_int(args[4], &i_opcode) == -1) {
+        return NULL;
+    }
+
+    char       *mask;
+    Py_ssize_t  mask_len;
+
+    if (PyBytes_AsStringAndSize(i_mask, &mask, &mask_len) == -1) {
+        return NULL;
+    }
+
+    if (mask_len != 4 && mask_len != 0) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid mask: length != 4"
+        );
+        return NULL;
+    }
+
+    char       *payload;
+    Py_ssize_t  amount;
+
+    if (PyBytes_AsStringAndSize(i_payload, &payload, &amount) == -1) {
+        return NULL;
+    }
+
+    Py_buffer i_buffer;
+    if (PyObject_GetBuffer(args[7], &i_buffer, PyBUF_WRITABLE) == -1) {
+        return NULL;
+    }
+
+    char header[14];
+    int header_offset = _build_header(header, i_fin, i_rsv1, i_rsv2, i_rsv3, i_opcode, mask, mask_len, amount);
+
+    if (header_offset + amount > i_buffer.len) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid buffer: length (%zd) < encoded size (%zd)",
+            i_buffer.len, header_offset + amount
+        );
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+
+    char *o_data = (char *)i_buffer.buf;
+    memcpy(o_data, header, header_offset);
+
+    if (amount >= NOGIL_THRESHOLD) {
+        Py_BEGIN_ALLOW_THREADS
+        if (mask_len) {
+            _masking_run(payload, o_data + header_offset, amount, mask);
+        } else {
+            memcpy(o_data + header_offset, payload, amount);
+        }
+        Py_END_ALLOW_THREADS
+    } else {
+        if (mask_len) {
+            _masking_run(payload, o_data + header_offset, amount, mask);
+        } else {
+            memcpy(o_data + header_offset, payload, amount);
+        }
+    }
+
+    PyBuffer_Release(&i_buffer);
+    return PyLong_FromSsize_t(header_offset + amount);
+}
+
+
+static PyObject * parse_into(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    STATS_INC(calls_parse_into);
+    if (_check_nargs("parse_into", nargs, 3, 3) == -1) {
+        return NULL;
+    }
+    Py_ssize_t  i_len;
+    char       *i_data;
+    int         i_autodemask;
+
+    if (_as_bool(args[1], &i_autodemask) == -1) {
+        return NULL;
+    }
+    if (PyBytes_AsStringAndSize(args[0], &i_data, &i_len) == -1) {
+        return NULL;
+    }
+
+    uint64_t _header_offset = 2;
+
+    if ((uint64_t)i_len < _header_offset) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: data length < 2"
+        );
+        return NULL;
+    }
+
+    unsigned char *_input = (unsigned char *)i_data;
+
+    char _b1 = _input[0];
+    int      fin         = (_b1 & 0b10000000) >> 7;
+    int      rsv1        = (_b1 & 0b01000000) >> 6;
+    int      rsv2        = (_b1 & 0b00100000) >> 5;
+    int      rsv3        = (_b1 & 0b00010000) >> 4;
+    int      opcode      = (_b1 & 0b00001111);
+    char _b2 = _input[1];
+    int      masked      = (_b2 & 0b10000000) >> 7;
+    int      amount_spec = (_b2 & 0b01111111);
+
+    uint64_t _header_size = 2;
+    if (amount_spec == 126) {
+        _header_size += 2;
+    } else if (amount_spec == 127) {
+        _header_size += 8;
+    }
+    if (masked) {
+        _header_size += 4;
+    }
+    if ((uint64_t)i_len < _header_size) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: data length (%d) < header length (%d)",
+            i_len, _header_size
+        );
+        return NULL;
+    }
+    uint64_t amount;
+
+    if (amount_spec == 126) {
+        amount =  (uint64_t)_input[2];
+        amount <<= 8;
+        amount |= (uint64_t)_input[3];
+        _header_offset += 2;
+    } else if (amount_spec == 127) {
+        amount =  (uint64_t)_input[2];
+        amount <<= 8;
+        amount |= (uint64_t)_input[3];
+        amount <<= 8;
+        amount |= (uint64_t)_input[4];
+        amount <<= 8;
+        amount |= (uint64_t)_input[5];
+        amount <<= 8;
+        amount |= (uint64_t)_input[6];
+        amount <<= 8;
+        amount |= (uint64_t)_input[7];
+        amount <<= 8;
+        amount |= (uint64_t)_input[8];
+        amount <<= 8;
+        amount |= (uint64_t)_input[9];
+        _header_offset += 8;
+    } else {
+        amount = amount_spec;
+    }
+
+    char mask[4] = {0, 0, 0, 0};
+    if (masked) {
+        memcpy(mask, _input + _header_offset, 4);
+        _header_offset += 4;
+    }
+
+    uint64_t _edl = _header_offset + amount;
+    if (_edl != (uint64_t)i_len) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: data length (%d) != expected data length (%d)",
+            i_len, _edl
+        );
+        return NULL;
+    }
+
+    Py_buffer i_buffer;
+    if (PyObject_GetBuffer(args[2], &i_buffer, PyBUF_WRITABLE) == -1) {
+        return NULL;
+    }
+    if ((uint64_t)i_buffer.len < amount) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid buffer: length (%zd) < payload length (%llu)",
+            i_buffer.len, (unsigned long long)amount
+        );
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+
+    char *_payload = (char *)_input + _header_offset;
+    char *o_data = (char *)i_buffer.buf;
+    int demask = i_autodemask & masked;
+
+    if ((Py_ssize_t)amount >= NOGIL_THRESHOLD) {
+        Py_BEGIN_ALLOW_THREADS
+        if (demask) {
+            _masking_run(_payload, o_data, amount, mask);
+        } else {
+            memcpy(o_data, _payload, amount);
+        }
+        Py_END_ALLOW_THREADS
+    } else {
+        if (demask) {
+            _masking_run(_payload, o_data, amount, mask);
+        } else {
+            memcpy(o_data, _payload, amount);
+        }
+    }
+
+    PyBuffer_Release(&i_buffer);
+    STATS_INC(frames_parsed);
+    return Py_BuildValue(
+        "(i,i,i,i,i,i,i,K,y#)",
+        fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, mask, (Py_ssize_t)4
+    );
+}
+
+
+static PyObject * parse(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    STATS_INC(calls_parse);
+    if (_check_nargs("parse", nargs, 2, 4) == -1) {
+        return NULL;
+    }
+    PyObject   *i_obj = args[0];
+    Py_ssize_t  i_len;
+    char       *i_data;
+    int         i_autodemask;
+    int         i_validate_utf8 = 0;
+    Py_ssize_t  i_max_payload_len = 0;
+
+    char     *o_mask = NULL;
+    char     *o_masked_payload = NULL;
+    PyObject *o_obj = NULL;
+
+    if (_as_bool(args[1], &i_autodemask) == -1
+        || (nargs >= 3 && _as_bool(args[2], &i_validate_utf8) == -1)
+        || (nargs >= 4 && _as_ssize(args[3], &i_max_payload_len) == -1))
+    {
+        goto exit;
+    }
+
+    if (PyBytes_AsStringAndSize(i_obj, &i_data, &i_len) == -1) {
+        goto exit;
+    }
+
+    uint64_t _header_offset = 2;
+    
+    if ((uint64_t)i_len < _header_offset) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: data length < 2"
+        );
+        goto exit;
+    }
+
+    unsigned char *_input = (unsigned char *)i_data;
+
+    char _b1 = _input[0];
+    int      fin         = (_b1 & 0b10000000) >> 7;
+    int      rsv1        = (_b1 & 0b01000000) >> 6;
+    int      rsv2        = (_b1 & 0b00100000) >> 5;
+    int      rsv3        = (_b1 & 0b00010000) >> 4;
+    int      opcode      = (_b1 & 0b00001111);
+    char _b2 = _input[1];
+    int      masked      = (_b2 & 0b10000000) >> 7;
+    int      amount_spec = (_b2 & 0b01111111);
+
+    uint64_t _header_size = 2;
+    if (amount_spec == 126) {
+        _header_size += 2;
+    } else if (amount_spec == 127) {
+        _header_size += 8;
+    }
+    if (masked) {
+        _header_size += 4;
+    }
+    if ((uint64_t)i_len < _header_size) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: data length (%d) < header length (%d)",
+            i_len, _header_size
+        );
+        goto exit;
+    }
+    uint64_t amount;
+    
+    if (amount_spec == 126) {
+        amount =  (uint64_t)_input[2];
+        amount <<= 8;
+        amount |= (uint64_t)_input[3];
+        _header_offset += 2;
+    } else if (amount_spec == 127) {
+        amount =  (uint64_t)_input[2];
+        amount <<= 8;
+        amount |= (uint64_t)_input[3];
+        amount <<= 8;
+        amount |= (uint64_t)_input[4];
+        amount <<= 8;
+        amount |= (uint64_t)_input[5];
+        amount <<= 8;
+        amount |= (uint64_t)_input[6];
+        amount <<= 8;
+        amount |= (uint64_t)_input[7];
+        amount <<= 8;
+        amount |= (uint64_t)_input[8];
+        amount <<= 8;
+        amount |= (uint64_t)_input[9];
+        _header_offset += 8;
+    } else {
+        amount = amount_spec;
+    }
+
+    if (i_max_payload_len && amount > (uint64_t)i_max_payload_len) {
+        // reject before any allocation is sized from the claimed length
+        wsframecoder_state *state = (wsframecoder_state *)PyModule_GetState(self);
+        _raise_payload_too_long(state->PayloadTooLong, amount, i_max_payload_len);
+        goto exit;
+    }
+
+    o_mask = (char*)malloc(4 * sizeof(char));
+    if (o_mask == NULL) {
+        STATS_INC(alloc_failures);
+        PyErr_Format(
+            PyExc_SystemError,
+            "Memory allocation failed"
+        );
+        goto exit;
+    };
+    if (masked) {
+        memcpy(o_mask, _input + _header_offset, 4);
+        _header_offset += 4;
+    }
+
+    uint64_t _edl = _header_offset + amount;
+    if (_edl != (uint64_t)i_len) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: data length (%d) != expected data length (%d)",
+            i_len, _edl
+        );
+        goto exit;
+    }
+
+    if (i_validate_utf8 && opcode == 0b00000001 && fin) {
+        // validate the payload as it will be returned, i.e. after the
+        // demask pass while the data is still hot in cache
+        const char *_vp;
+        if (i_autodemask & masked) {
+            o_masked_payload = _masking((char*)_input + _header_offset, amount, o_mask);
+            if (o_masked_payload == NULL) {
+                goto exit;
+            }
+            _vp = o_masked_payload;
+        } else {
+            _vp = (char*)_input + _header_offset;
+        }
+        int valid;
+        if ((Py_ssize_t)amount >= NOGIL_THRESHOLD) {
+            Py_BEGIN_ALLOW_THREADS
+            valid = _validate_utf8(_vp, amount);
+            Py_END_ALLOW_THREADS
+        } else {
+            valid = _validate_utf8(_vp, amount);
+        }
+        if (!valid) {
+            PyErr_Format(
+                PyExc_ValueError,
+                "invalid frame: payload is not valid utf-8"
+            );
+            goto exit;
+        }
+    }
+
+    if (o_masked_payload != NULL) {
+        o_obj = Py_BuildValue(
+            "(i,i,i,i,i,i,i,i,y#,y#)",
+            fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, o_mask, 4, o_masked_payload, amount
+        );
+    } else if (i_autodemask & masked) {
+        o_masked_payload = _masking((char*)_input + _header_offset, amount, o_mask);
+        if (o_masked_payload == NULL) {
+            goto exit;
+        }
+        o_obj = Py_BuildValue(
+            "(i,i,i,i,i,i,i,i,y#,y#)",
+            fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, o_mask, 4, o_masked_payload, amount
+        );
+    } else {
+        o_obj = Py_BuildValue(
+            "(i,i,i,i,i,i,i,i,y#,y#)",
+            fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, o_mask, 4, (char*)_input + _header_offset, amount
+        );
+    }
+    if (o_obj != NULL) {
+        STATS_INC(frames_parsed);
+    }
+
+exit:
+    free(o_mask);
+    free(o_masked_payload);
+    return o_obj;
+}
+
+
+
+static PyObject * parse_all(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    STATS_INC(calls_parse_all);
+    if (_check_nargs("parse_all", nargs, 2, 3) == -1) {
+        return NULL;
+    }
+    Py_buffer  i_buffer;
+    int        i_autodemask;
+    Py_ssize_t i_max_payload_len = 0;
+
+    if (_as_bool(args[1], &i_autodemask) == -1
+        || (nargs >= 3 && _as_ssize(args[2], &i_max_payload_len) == -1)) {
+        return NULL;
+    }
+    if (PyObject_GetBuffer(args[0], &i_buffer, PyBUF_SIMPLE) == -1) {
+        return NULL;
+    }
+
+    PyObject *o_frames = PyList_New(0);
+    if (o_frames == NULL) {
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+
+    char       *i_data = (char *)i_buffer.buf;
+    Py_ssize_t  i_len = i_buffer.len;
+    Py_ssize_t  pos = 0;
+
+    for (;;) {
+        Py_ssize_t rem = i_len - pos;
+        if (rem < 2) {
+            break;
+        }
+
+        unsigned char *_input = (unsigned char *)(i_data + pos);
+
+        char _b1 = _input[0];
+        int      fin         = (_b1 & 0b10000000) >> 7;
+        int      rsv1        = (_b1 & 0b01000000) >> 6;
+        int      rsv2        = (_b1 & 0b00100000) >> 5;
+        int      rsv3        = (_b1 & 0b00010000) >> 4;
+        int      opcode      = (_b1 & 0b00001111);
+        char _b2 = _input[1];
+        int      masked      = (_b2 & 0b10000000) >> 7;
+        int      amount_spec = (_b2 & 0b01111111);
+
+        uint64_t _header_size = 2;
+        if (amount_spec == 126) {
+            _header_size += 2;
+        } else if (amount_spec == 127) {
+            _header_size += 8;
+        }
+        if (masked) {
+            _header_size += 4;
+        }
+
+        if ((uint64_t)rem < _header_size) {
+            break;
+        }
+
+        uint64_t amount;
+        uint64_t _header_offset = 2;
+        if (amount_spec == 126) {
+            amount =  (uint64_t)_input[2];
+            amount <<= 8;
+            amount |= (uint64_t)_input[3];
+            _header_offset += 2;
+        } else if (amount_spec == 127) {
+            amount =  (uint64_t)_input[2];
+            amount <<= 8;
+            amount |= (uint64_t)_input[3];
+            amount <<= 8;
+            amount |= (uint64_t)_input[4];
+            amount <<= 8;
+            amount |= (uint64_t)_input[5];
+            amount <<= 8;
+            amount |= (uint64_t)_input[6];
+            amount <<= 8;
+            amount |= (uint64_t)_input[7];
+            amount <<= 8;
+            amount |= (uint64_t)_input[8];
+            amount <<= 8;
+            amount |= (uint64_t)_input[9];
+            if (amount >> 63) {
+                // RFC 6455: the most significant bit of the 64-bit length must be 0
+                PyErr_Format(
+                    PyExc_ValueError,
+                    "invalid frame: most significant bit of the 64-bit payload length is set"
+                );
+                goto fail;
+            }
+            _header_offset += 8;
+        } else {
+            amount = amount_spec;
+        }
+
+        if (i_max_payload_len && amount > (uint64_t)i_max_payload_len) {
+            // reject before any allocation is sized from the claimed length
+            wsframecoder_state *_state = (wsframecoder_state *)PyModule_GetState(self);
+            _raise_payload_too_long(_state->PayloadTooLong, amount, i_max_payload_len);
+            goto fail;
+        }
+
+        char mask[4] = {0, 0, 0, 0};
+        if (masked) {
+            memcpy(mask, _input + _header_offset, 4);
+        }
+
+        if ((uint64_t)rem < _header_size + amount) {
+            break;
+        }
+
+        char *_payload = (char *)_input + _header_size;
+        int demask = i_autodemask & masked;
+
+        PyObject *o_payload = PyBytes_FromStringAndSize(NULL, amount);
+        if (o_payload == NULL) {
+            goto fail;
+        }
+        char *o_payload_data = PyBytes_AS_STRING(o_payload);
+        if ((Py_ssize_t)amount >= NOGIL_THRESHOLD) {
+            Py_BEGIN_ALLOW_THREADS
+            if (demask) {
+                _masking_run(_payload, o_payload_data, amount, mask);
+            } else {
+                memcpy(o_payload_data, _payload, amount);
+            }
+            Py_END_ALLOW_THREADS
+        } else {
+            if (demask) {
+                _masking_run(_payload, o_payload_data, amount, mask);
+            } else {
+                memcpy(o_payload_data, _payload, amount);
+            }
+        }
+
+        PyObject *o_frame = Py_BuildValue(
+            "(i,i,i,i,i,i,i,K,y#,N)",
+            fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, mask, (Py_ssize_t)4, o_payload
+        );
+        if (o_frame == NULL) {
+            goto fail;
+        }
+        int append_failed = PyList_Append(o_frames, o_frame);
+        Py_DECREF(o_frame);
+        if (append_failed) {
+            goto fail;
+        }
+        STATS_INC(frames_parsed);
+
+        pos += _header_size + amount;
+    }
+
+    PyBuffer_Release(&i_buffer);
+    return Py_BuildValue("(N,n)", o_frames, i_len - pos);
+
+fail:
+    PyBuffer_Release(&i_buffer);
+    Py_DECREF(o_frames);
+    return NULL;
+}
+
+
+// the Frame result type: a struct sequence with the field names and
+// order of the python Frame NamedTuple, so both compare and unpack as
+// the same tuple; built directly inside parse_frame instead of a
+// second construction in python
+
+static PyStructSequence_Field Frame_fields[] = {
+    {"payload", "masked/de-masked payload"},
+    {"opcode", "message type"},
+    {"mask", "masking key, None if the payload is not masked"},
+    {"fin", "final fragment flag"},
+    {"rsv1", "reserved for extension of the specification"},
+    {"rsv2", "reserved for extension of the specification"},
+    {"rsv3", "reserved for extension of the specification"},
+    {"amount_spec", "payload size type field of the header"},
+    {"amount", "the actual payload size"},
+    {NULL, NULL},
+};
+
+static PyStructSequence_Desc Frame_desc = {
+    "_wsframecoder.Frame",
+    "WebSocket frame parsed in c, field-compatible with wsdatautil.Frame",
+    Frame_fields,
+    9,
+};
+
+
+static PyObject * parse_frame(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    STATS_INC(calls_parse_frame);
+    if (_check_nargs("parse_frame", nargs, 2, 4) == -1) {
+        return NULL;
+    }
+    PyObject   *i_obj = args[0];
+    Py_ssize_t  i_len;
+    char       *i_data;
+    int         i_autodemask;
+    int         i_validate_utf8 = 0;
+    Py_ssize_t  i_max_payload_len = 0;
+
+    char     *o_masked_payload = NULL;
+    PyObject *o_payload = NULL;
+    PyObject *o_obj = NULL;
+
+    if (_as_bool(args[1], &i_autodemask) == -1
+        || (nargs >= 3 && _as_bool(args[2], &i_validate_utf8) == -1)
+        || (nargs >= 4 && _as_ssize(args[3], &i_max_payload_len) == -1))
+    {
+        goto exit;
+    }
+
+    if (PyBytes_AsStringAndSize(i_obj, &i_data, &i_len) == -1) {
+        goto exit;
+    }
+
+    uint64_t _header_offset = 2;
+
+    if ((uint64_t)i_len < _header_offset) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: data length < 2"
+        );
+        goto exit;
+    }
+
+    unsigned char *_input = (unsigned char *)i_data;
+
+    char _b1 = _input[0];
+    int      fin         = (_b1 & 0b10000000) >> 7;
+    int      rsv1        = (_b1 & 0b01000000) >> 6;
+    int      rsv2        = (_b1 & 0b00100000) >> 5;
+    int      rsv3        = (_b1 & 0b00010000) >> 4;
+    int      opcode      = (_b1 & 0b00001111);
+    char _b2 = _input[1];
+    int      masked      = (_b2 & 0b10000000) >> 7;
+    int      amount_spec = (_b2 & 0b01111111);
+
+    uint64_t _header_size = 2;
+    if (amount_spec == 126) {
+        _header_size += 2;
+    } else if (amount_spec == 127) {
+        _header_size += 8;
+    }
+    if (masked) {
+        _header_size += 4;
+    }
+    if ((uint64_t)i_len < _header_size) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: data length (%d) < header length (%d)",
+            i_len, _header_size
+        );
+        goto exit;
+    }
+    uint64_t amount;
+
+    if (amount_spec == 126) {
+        amount =  (uint64_t)_input[2];
+        amount <<= 8;
+        amount |= (uint64_t)_input[3];
+        _header_offset += 2;
+    } else if (amount_spec == 127) {
+        amount =  (uint64_t)_input[2];
+        amount <<= 8;
+        amount |= (uint64_t)_input[3];
+        amount <<= 8;
+        amount |= (uint64_t)_input[4];
+        amount <<= 8;
+        amount |= (uint64_t)_input[5];
+        amount <<= 8;
+        amount |= (uint64_t)_input[6];
+        amount <<= 8;
+        amount |= (uint64_t)_input[7];
+        amount <<= 8;
+        amount |= (uint64_t)_input[8];
+        amount <<= 8;
+        amount |= (uint64_t)_input[9];
+        _header_offset += 8;
+    } else {
+        amount = amount_spec;
+    }
+
+    if (i_max_payload_len && amount > (uint64_t)i_max_payload_len) {
+        // reject before any allocation is sized from the claimed length
+        wsframecoder_state *_state = (wsframecoder_state *)PyModule_GetState(self);
+        _raise_payload_too_long(_state->PayloadTooLong, amount, i_max_payload_len);
+        goto exit;
+    }
+
+    char mask[4] = {0, 0, 0, 0};
+    if (masked) {
+        memcpy(mask, _input + _header_offset, 4);
+        _header_offset += 4;
+    }
+
+    uint64_t _edl = _header_offset + amount;
+    if (_edl != (uint64_t)i_len) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: data length (%d) != expected data length (%d)",
+            i_len, _edl
+        );
+        goto exit;
+    }
+
+    if (i_autodemask & masked) {
+        o_masked_payload = _masking((char*)_input + _header_offset, amount, mask);
+        if (o_masked_payload == NULL) {
+            goto exit;
+        }
+    }
+
+    const char *_pp = o_masked_payload != NULL ? o_masked_payload : (char*)_input + _header_offset;
+
+    if (i_validate_utf8 && opcode == 0b00000001 && fin) {
+        int valid;
+        if ((Py_ssize_t)amount >= NOGIL_THRESHOLD) {
+            Py_BEGIN_ALLOW_THREADS
+            valid = _validate_utf8(_pp, amount);
+            Py_END_ALLOW_THREADS
+        } else {
+            valid = _validate_utf8(_pp, amount);
+        }
+        if (!valid) {
+            PyErr_Format(
+                PyExc_ValueError,
+                "invalid frame: payload is not valid utf-8"
+            );
+            goto exit;
+        }
+    }
+
+    o_payload = PyBytes_FromStringAndSize(_pp, amount);
+    if (o_payload == NULL) {
+        goto exit;
+    }
+
+    wsframecoder_state *state = (wsframecoder_state *)PyModule_GetState(self);
+    o_obj = PyStructSequence_New((PyTypeObject *)state->FrameType);
+    if (o_obj == NULL) {
+        goto exit;
+    }
+
+    PyObject *o_mask;
+    if (masked) {
+        o_mask = PyBytes_FromStringAndSize(mask, 4);
+        if (o_mask == NULL) {
+            Py_CLEAR(o_obj);
+            goto exit;
+        }
+    } else {
+        o_mask = Py_None;
+        Py_INCREF(o_mask);
+    }
+
+    // SET_ITEM steals the references
+    PyStructSequence_SET_ITEM(o_obj, 0, o_payload);
+    o_payload = NULL;
+    PyStructSequence_SET_ITEM(o_obj, 1, PyLong_FromLong(opcode));
+    PyStructSequence_SET_ITEM(o_obj, 2, o_mask);
+    PyStructSequence_SET_ITEM(o_obj, 3, PyLong_FromLong(fin));
+    PyStructSequence_SET_ITEM(o_obj, 4, PyLong_FromLong(rsv1));
+    PyStructSequence_SET_ITEM(o_obj, 5, PyLong_FromLong(rsv2));
+    PyStructSequence_SET_ITEM(o_obj, 6, PyLong_FromLong(rsv3));
+    PyStructSequence_SET_ITEM(o_obj, 7, PyLong_FromLong(amount_spec));
+    PyStructSequence_SET_ITEM(o_obj, 8, PyLong_FromUnsignedLongLong(amount));
+
+    for (int i = 1; i < 9; i++) {
+        if (PyStructSequence_GET_ITEM(o_obj, i) == NULL) {
+            Py_CLEAR(o_obj);
+            goto exit;
+        }
+    }
+    STATS_INC(frames_parsed);
+
+exit:
+    free(o_masked_payload);
+    Py_XDECREF(o_payload);
+    return o_obj;
+}
+
+
+static PyObject * parse_partial(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    STATS_INC(calls_parse_partial);
+    if (_check_nargs("parse_partial", nargs, 3, 3) == -1) {
+        return NULL;
+    }
+    Py_buffer  i_buffer;
+    Py_ssize_t i_offset;
+    int        i_autodemask;
+
+    if (_as_ssize(args[1], &i_offset) == -1
+        || _as_bool(args[2], &i_autodemask) == -1) {
+        return NULL;
+    }
+    if (PyObject_GetBuffer(args[0], &i_buffer, PyBUF_SIMPLE) == -1) {
+        return NULL;
+    }
+    if (i_offset < 0 || i_offset > i_buffer.len) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid offset: not in [0, %zd]",
+            i_buffer.len
+        );
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+
+    Py_ssize_t rem = i_buffer.len - i_offset;
+
+    if (rem < 2) {
+        PyBuffer_Release(&i_buffer);
+        return Py_BuildValue("(O,n)", Py_None, (Py_ssize_t)2 - rem);
+    }
+
+    unsigned char *_input = (unsigned char *)i_buffer.buf + i_offset;
+
+    char _b1 = _input[0];
+    int      fin         = (_b1 & 0b10000000) >> 7;
+    int      rsv1        = (_b1 & 0b01000000) >> 6;
+    int      rsv2        = (_b1 & 0b00100000) >> 5;
+    int      rsv3        = (_b1 & 0b00010000) >> 4;
+    int      opcode      = (_b1 & 0b00001111);
+    char _b2 = _input[1];
+    int      masked      = (_b2 & 0b10000000) >> 7;
+    int      amount_spec = (_b2 & 0b01111111);
+
+    uint64_t _header_size = 2;
+    if (amount_spec == 126) {
+        _header_size += 2;
+    } else if (amount_spec == 127) {
+        _header_size += 8;
+    }
+    if (masked) {
+        _header_size += 4;
+    }
+
+    if ((uint64_t)rem < _header_size) {
+        PyBuffer_Release(&i_buffer);
+        return Py_BuildValue("(O,n)", Py_None, (Py_ssize_t)(_header_size - rem));
+    }
+
+    uint64_t amount;
+    uint64_t _header_offset = 2;
+    if (amount_spec == 126) {
+        amount =  (uint64_t)_input[2];
+        amount <<= 8;
+        amount |= (uint64_t)_input[3];
+        _header_offset += 2;
+    } else if (amount_spec == 127) {
+        amount =  (uint64_t)_input[2];
+        amount <<= 8;
+        amount |= (uint64_t)_input[3];
+        amount <<= 8;
+        amount |= (uint64_t)_input[4];
+        amount <<= 8;
+        amount |= (uint64_t)_input[5];
+        amount <<= 8;
+        amount |= (uint64_t)_input[6];
+        amount <<= 8;
+        amount |= (uint64_t)_input[7];
+        amount <<= 8;
+        amount |= (uint64_t)_input[8];
+        amount <<= 8;
+        amount |= (uint64_t)_input[9];
+        if (amount >> 63) {
+            // RFC 6455: the most significant bit of the 64-bit length must be 0
+            PyErr_Format(
+                PyExc_ValueError,
+                "invalid frame: most significant bit of the 64-bit payload length is set"
+            );
+            PyBuffer_Release(&i_buffer);
+            return NULL;
+        }
+        _header_offset += 8;
+    } else {
+        amount = amount_spec;
+    }
+
+    char mask[4] = {0, 0, 0, 0};
+    if (masked) {
+        memcpy(mask, _input + _header_offset, 4);
+    }
+
+    if ((uint64_t)rem < _header_size + amount) {
+        PyBuffer_Release(&i_buffer);
+        return Py_BuildValue("(O,n)", Py_None, (Py_ssize_t)(_header_size + amount - rem));
+    }
+
+    char *_payload = (char *)_input + _header_size;
+    int demask = i_autodemask & masked;
+
+    PyObject *o_payload = PyBytes_FromStringAndSize(NULL, amount);
+    if (o_payload == NULL) {
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+    char *o_payload_data = PyBytes_AS_STRING(o_payload);
+    if ((Py_ssize_t)amount >= NOGIL_THRESHOLD) {
+        Py_BEGIN_ALLOW_THREADS
+        if (demask) {
+            _masking_run(_payload, o_payload_data, amount, mask);
+        } else {
+            memcpy(o_payload_data, _payload, amount);
+        }
+        Py_END_ALLOW_THREADS
+    } else {
+        if (demask) {
+            _masking_run(_payload, o_payload_data, amount, mask);
+        } else {
+            memcpy(o_payload_data, _payload, amount);
+        }
+    }
+
+    PyBuffer_Release(&i_buffer);
+    STATS_INC(frames_parsed);
+    return Py_BuildValue(
+        "((i,i,i,i,i,i,i,K,y#,N),n)",
+        fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, mask, (Py_ssize_t)4, o_payload,
+        (Py_ssize_t)(_header_size + amount)
+    );
+}
+
+
+static PyObject * _memoryview_slice(PyObject *mview, Py_ssize_t start, Py_ssize_t stop) {
+    PyObject *o_start = PyLong_FromSsize_t(start);
+    PyObject *o_stop = PyLong_FromSsize_t(stop);
+    PyObject *slice = NULL;
+    PyObject *o_view = NULL;
+    if (o_start == NULL || o_stop == NULL) {
+        goto exit;
+    }
+    slice = PySlice_New(o_start, o_stop, NULL);
+    if (slice == NULL) {
+        goto exit;
+    }
+    o_view = PyObject_GetItem(mview, slice);
+
+exit:
+    Py_XDECREF(o_start);
+    Py_XDECREF(o_stop);
+    Py_XDECREF(slice);
+    return o_view;
+}
+
+
+static PyObject * parse_view(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (_check_nargs("parse_view", nargs, 1, 1) == -1) {
+        return NULL;
+    }
+
+    PyObject *o_mview = NULL;
+    PyObject *o_mask = NULL;
+    PyObject *o_payload = NULL;
+    PyObject *o_obj = NULL;
+
+    o_mview = PyMemoryView_FromObject(args[0]);
+    if (o_mview == NULL) {
+        goto exit;
+    }
+
+    Py_buffer *_buffer = PyMemoryView_GET_BUFFER(o_mview);
+    if (!PyBuffer_IsContiguous(_buffer, 'C')) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: buffer is not contiguous"
+        );
+        goto exit;
+    }
+
+    Py_ssize_t i_len = _buffer->len;
+    char *i_data = (char *)_buffer->buf;
+
+    uint64_t _header_offset = 2;
+
+    if ((uint64_t)i_len < _header_offset) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: data length < 2"
+        );
+        goto exit;
+    }
+
+    unsigned char *_input = (unsigned char *)i_data;
+
+    char _b1 = _input[0];
+    int      fin         = (_b1 & 0b10000000) >> 7;
+    int      rsv1        = (_b1 & 0b01000000) >> 6;
+    int      rsv2        = (_b1 & 0b00100000) >> 5;
+    int      rsv3        = (_b1 & 0b00010000) >> 4;
+    int      opcode      = (_b1 & 0b00001111);
+    char _b2 = _input[1];
+    int      masked      = (_b2 & 0b10000000) >> 7;
+    int      amount_spec = (_b2 & 0b01111111);
+
+    uint64_t _header_size = 2;
+    if (amount_spec == 126) {
+        _header_size += 2;
+    } else if (amount_spec == 127) {
+        _header_size += 8;
+    }
+    if (masked) {
+        _header_size += 4;
+    }
+    if ((uint64_t)i_len < _header_size) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: data length (%d) < header length (%d)",
+            i_len, _header_size
+        );
+        goto exit;
+    }
+    uint64_t amount;
+
+    if (amount_spec == 126) {
+        amount =  (uint64_t)_input[2];
+        amount <<= 8;
+        amount |= (uint64_t)_input[3];
+        _header_offset += 2;
+    } else if (amount_spec == 127) {
+        amount =  (uint64_t)_input[2];
+        amount <<= 8;
+        amount |= (uint64_t)_input[3];
+        amount <<= 8;
+        amount |= (uint64_t)_input[4];
+        amount <<= 8;
+        amount |= (uint64_t)_input[5];
+        amount <<= 8;
+        amount |= (uint64_t)_input[6];
+        amount <<= 8;
+        amount |= (uint64_t)_input[7];
+        amount <<= 8;
+        amount |= (uint64_t)_input[8];
+        amount <<= 8;
+        amount |= (uint64_t)_input[9];
+        _header_offset += 8;
+    } else {
+        amount = amount_spec;
+    }
+
+    uint64_t _mask_offset = _header_offset;
+    if (masked) {
+        _header_offset += 4;
+    }
+
+    uint64_t _edl = _header_offset + amount;
+    if (_edl != (uint64_t)i_len) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid frame: data length (%d) != expected data length (%d)",
+            i_len, _edl
+        );
+        goto exit;
+    }
+
+    o_mask = _memoryview_slice(o_mview, _mask_offset, _header_offset);
+    if (o_mask == NULL) {
+        goto exit;
+    }
+    o_payload = _memoryview_slice(o_mview, _header_offset, _edl);
+    if (o_payload == NULL) {
+        goto exit;
+    }
+
+    o_obj = Py_BuildValue(
+        "(i,i,i,i,i,i,i,i,O,O)",
+        fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, o_mask, o_payload
+    );
+
+exit:
+    Py_XDECREF(o_mview);
+    Py_XDECREF(o_mask);
+    Py_XDECREF(o_payload);
+    return o_obj;
+}
+
+
+static PyObject * read_header(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    Py_ssize_t  i_len;
+    char       *i_data;
+
+    PyObject *o_obj = NULL;
+
+    if (_check_nargs("read_header", nargs, 1, 1) == -1)
+    {
+        goto exit;
+    }
+
+    if (PyBytes_AsStringAndSize(args[0], &i_data, &i_len) == -1) {
+        goto exit;
+    }
+    
+    if ((uint64_t)i_len != 2) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid header: data length != 2"
+        );
+        goto exit;
+    }
+    
+    unsigned char *_input = (unsigned char *)i_data;
+
+    char _b1 = _input[0];
+    int      fin         = (_b1 & 0b10000000) >> 7;
+    int      rsv1        = (_b1 & 0b01000000) >> 6;
+    int      rsv2        = (_b1 & 0b00100000) >> 5;
+    int      rsv3        = (_b1 & 0b00010000) >> 4;
+    int      opcode      = (_b1 & 0b00001111);
+    char _b2 = _input[1];
+    int      masked      = (_b2 & 0b10000000) >> 7;
+    int      amount_spec = (_b2 & 0b01111111);
+
+    int      header_continuation = 0;
+    
+    if (amount_spec == 126) {
+        header_continuation += 2;
+    } else if (amount_spec == 127) {
+        header_continuation += 8;
+    }
+    
+    if (masked) {
+        header_continuation += 4;
+    }
+
+    o_obj = Py_BuildValue(
+        "(i,i,i,i,i,i,i,i)",
+        fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, header_continuation
+    );
+
+exit:
+    return o_obj;
+}
+
+
+
+static PyObject * read_header_continuation(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    Py_ssize_t  i_len;
+    char       *i_data;
+    int         i_amount_spec;
+    int         i_masked;
+
+    char     *o_mask = NULL;
+    PyObject *o_obj = NULL;
+
+    if (_check_nargs("read_header_continuation", nargs, 3, 3) == -1
+        || _as_int(args[1], &i_amount_spec) == -1
+        || _as_bool(args[2], &i_masked) == -1)
+    {
+        goto exit;
+    }
+
+    if (PyBytes_AsStringAndSize(args[0], &i_data, &i_len) == -1) {
+        goto exit;
+    }
+
+    unsigned char *_input = (unsigned char *)i_data;
+
+    uint64_t _header_size = 0;
+    
+    uint64_t amount;
+
+    // xo
+    if (i_amount_spec == 126) {
+        amount =  (uint64_t)_input[0];
+        amount <<= 8;
+        amount |= (uint64_t)_input[1];
+        _header_size += 2;
+    } else if (i_amount_spec == 127) {
+        amount =  (uint64_t)_input[0];
+        amount <<= 8;
+        amount |= (uint64_t)_input[1];
+        amount <<= 8;
+        amount |= (uint64_t)_input[2];
+        amount <<= 8;
+        amount |= (uint64_t)_input[3];
+        amount <<= 8;
+        amount |= (uint64_t)_input[4];
+        amount <<= 8;
+        amount |= (uint64_t)_input[5];
+        amount <<= 8;
+        amount |= (uint64_t)_input[6];
+        amount <<= 8;
+        amount |= (uint64_t)_input[7];
+        _header_size += 8;
+    } else {
+        amount = i_amount_spec;
+    }
+    
+    o_mask = (char*)malloc(4 * sizeof(char));
+    if (o_mask == NULL) {
+        STATS_INC(alloc_failures);
+        PyErr_Format(
+            PyExc_SystemError,
+            "Memory allocation failed"
+        );
+        goto exit;
+    };
+    if (i_masked) {
+        memcpy(o_mask, _input + _header_size, 4);
+        _header_size += 4;
+    }
+
+    if ((uint64_t)i_len != _header_size) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid header: data length (%d) != expected data length (%d)",
+            i_len, _header_size
+        );
+        goto exit;
+    }
+    
+    
+    o_obj = Py_BuildValue(
+        "(y#,i)",
+        o_mask, 4, amount
+    );
+
+exit:
+    free(o_mask);
+    return o_obj;
+}
+
+
+
+// handshake header coding: one pass over the upgrade request instead of
+// strip/split chains in python (memchr does the vectorized line scan)
+
+static PyObject * parse_http_headers(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    Py_buffer i_buffer = {NULL, NULL};
+
+    PyObject *o_l1 = NULL;
+    PyObject *o_items = NULL;
+    PyObject *o_obj = NULL;
+
+    if (_check_nargs("parse_http_headers", nargs, 1, 1) == -1) {
+        goto exit;
+    }
+
+    if (PyObject_GetBuffer(args[0], &i_buffer, PyBUF_SIMPLE) == -1) {
+        goto exit;
+    }
+
+    const char *p = (const char *)i_buffer.buf;
+    const char *end = p + i_buffer.len;
+
+    // outer strip as from_streamdata did before
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) {
+        end--;
+    }
+
+    o_items = PyList_New(0);
+    if (o_items == NULL) {
+        goto exit;
+    }
+
+    int first = 1;
+    while (p < end) {
+        // line = [p, eol), the terminating "\r\n" pair is skipped
+        const char *eol = end;
+        const char *next = end;
+        const char *cr = p;
+        while ((cr = (const char *)memchr(cr, '\r', end - cr)) != NULL) {
+            if (cr + 1 < end && cr[1] == '\n') {
+                eol = cr;
+                next = cr + 2;
+                break;
+            }
+            cr++;
+        }
+        if (first) {
+            o_l1 = PyBytes_FromStringAndSize(p, eol - p);
+            if (o_l1 == NULL) {
+                goto exit;
+            }
+            first = 0;
+        } else {
+            // split at the first ": " occurrence, the key is stripped
+            const char *sep = NULL;
+            const char *colon = p;
+            while ((colon = (const char *)memchr(colon, ':', eol - colon)) != NULL) {
+                if (colon + 1 < eol && colon[1] == ' ') {
+                    sep = colon;
+                    break;
+                }
+                colon++;
+            }
+            if (sep == NULL) {
+                PyErr_Format(
+                    PyExc_ValueError,
+                    "invalid header line: missing ': ' separator"
+                );
+                goto exit;
+            }
+            const char *k_start = p;
+            const char *k_end = sep;
+            while (k_start < k_end && (*k_start == ' ' || *k_start == '\t')) {
+                k_start++;
+            }
+            while (k_end > k_start && (k_end[-1] == ' ' || k_end[-1] == '\t')) {
+                k_end--;
+            }
+            PyObject *item = Py_BuildValue(
+                "(y#,y#)",
+                k_start, (Py_ssize_t)(k_end - k_start),
+                sep + 2, (Py_ssize_t)(eol - (sep + 2))
+            );
+            if (item == NULL) {
+                goto exit;
+            }
+            int err = PyList_Append(o_items, item);
+            Py_DECREF(item);
+            if (err == -1) {
+                goto exit;
+            }
+        }
+        p = next;
+    }
+
+    if (o_l1 == NULL) {
+        o_l1 = PyBytes_FromStringAndSize("", 0);
+        if (o_l1 == NULL) {
+            goto exit;
+        }
+    }
+
+    o_obj = Py_BuildValue("(O,O)", o_l1, o_items);
+
+exit:
+    if (i_buffer.buf != NULL) {
+        PyBuffer_Release(&i_buffer);
+    }
+    Py_XDECREF(o_l1);
+    Py_XDECREF(o_items);
+    return o_obj;
+}
+
+
+static PyObject * build_http_headers(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    PyObject *i_items = NULL;
+    PyObject *o_obj = NULL;
+
+    char       *l1;
+    Py_ssize_t  l1_len;
+
+    if (_check_nargs("build_http_headers", nargs, 2, 2) == -1) {
+        goto exit;
+    }
+
+    if (PyBytes_AsStringAndSize(args[0], &l1, &l1_len) == -1) {
+        goto exit;
+    }
+
+    i_items = PySequence_Fast(args[1], "build_http_headers() argument 2 must be a sequence");
+    if (i_items == NULL) {
+        goto exit;
+    }
+
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(i_items);
+    PyObject **items = PySequence_Fast_ITEMS(i_items);
+
+    // sizing pass: l1 "\r\n" + "k: v" lines joined by "\r\n" + "\r\n\r\n"
+    Py_ssize_t total = l1_len + 2 + 4;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        char       *k, *v;
+        Py_ssize_t  k_len, v_len;
+        if (!PyTuple_Check(items[i]) || PyTuple_GET_SIZE(items[i]) != 2) {
+            PyErr_Format(
+                PyExc_ValueError,
+                "invalid header item %zd: expected a (key, value) tuple",
+                i
+            );
+            goto exit;
+        }
+        if (PyBytes_AsStringAndSize(PyTuple_GET_ITEM(items[i], 0), &k, &k_len) == -1
+            || PyBytes_AsStringAndSize(PyTuple_GET_ITEM(items[i], 1), &v, &v_len) == -1) {
+            goto exit;
+        }
+        total += k_len + 2 + v_len + (i > 0 ? 2 : 0);
+    }
+
+    o_obj = PyBytes_FromStringAndSize(NULL, total);
+    if (o_obj == NULL) {
+        goto exit;
+    }
+
+    char *o_data = PyBytes_AS_STRING(o_obj);
+
+    memcpy(o_data, l1, l1_len);
+    o_data += l1_len;
+    memcpy(o_data, "\r\n", 2);
+    o_data += 2;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        char       *k, *v;
+        Py_ssize_t  k_len, v_len;
+        PyBytes_AsStringAndSize(PyTuple_GET_ITEM(items[i], 0), &k, &k_len);
+        PyBytes_AsStringAndSize(PyTuple_GET_ITEM(items[i], 1), &v, &v_len);
+        if (i > 0) {
+            memcpy(o_data, "\r\n", 2);
+            o_data += 2;
+        }
+        memcpy(o_data, k, k_len);
+        o_data += k_len;
+        memcpy(o_data, ": ", 2);
+        o_data += 2;
+        memcpy(o_data, v, v_len);
+        o_data += v_len;
+    }
+    memcpy(o_data, "\r\n\r\n", 4);
+
+exit:
+    Py_XDECREF(i_items);
+    return o_obj;
+}
+
+
+// compact SHA-1 (RFC 3174) for the handshake accept key; the inputs are
+// at most a few dozen bytes, so a plain portable implementation is
+// entirely sufficient here
+
+static uint32_t _sha1_rotl(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void _sha1(const unsigned char *input, size_t len, unsigned char digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint32_t w[80];
+
+    // message + 0x80 + zero padding + 64-bit bit length, in 64-byte blocks
+    size_t total = ((len + 8) / 64 + 1) * 64;
+    for (size_t block = 0; block < total; block += 64) {
+        for (int i = 0; i < 16; i++) {
+            uint32_t word = 0;
+            for (int j = 0; j < 4; j++) {
+                size_t pos = block + i * 4 + j;
+                unsigned char byte;
+                if (pos < len) {
+                    byte = input[pos];
+                } else if (pos == len) {
+                    byte = 0x80;
+                } else if (pos >= total - 8) {
+                    byte = (unsigned char)(((uint64_t)len * 8) >> ((total - 1 - pos) * 8));
+                } else {
+                    byte = 0;
+                }
+                word = (word << 8) | byte;
+            }
+            w[i] = word;
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = _sha1_rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | ((~b) & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t tmp = _sha1_rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = _sha1_rotl(b, 30);
+            b = a;
+            a = tmp;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4 + 0] = (unsigned char)(h[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(h[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(h[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)(h[i]);
+    }
+}
+
+
+static const char _b64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// base64 of the 20-byte SHA-1 digest -> 28 chars ("xxx=" padded tail)
+static void _b64_digest(const unsigned char digest[20], char out[28]) {
+    int o = 0;
+    for (int i = 0; i < 18; i += 3) {
+        uint32_t triple = ((uint32_t)digest[i] << 16) | ((uint32_t)digest[i + 1] << 8) | digest[i + 2];
+        out[o++] = _b64_alphabet[(triple >> 18) & 0b00111111];
+        out[o++] = _b64_alphabet[(triple >> 12) & 0b00111111];
+        out[o++] = _b64_alphabet[(triple >> 6)  & 0b00111111];
+        out[o++] = _b64_alphabet[(triple)       & 0b00111111];
+    }
+    uint32_t rest = ((uint32_t)digest[18] << 16) | ((uint32_t)digest[19] << 8);
+    out[o++] = _b64_alphabet[(rest >> 18) & 0b00111111];
+    out[o++] = _b64_alphabet[(rest >> 12) & 0b00111111];
+    out[o++] = _b64_alphabet[(rest >> 6)  & 0b00111111];
+    out[o++] = '=';
+}
+
+
+#define ACCEPT_GUID      "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define ACCEPT_GUID_LEN  36
+
+// key + GUID -> SHA-1 -> base64, without intermediate python objects
+static int _accept_key(const char *key, Py_ssize_t key_len, char out[28]) {
+    unsigned char digest[20];
+
+    size_t len = (size_t)key_len + ACCEPT_GUID_LEN;
+    unsigned char *input = (unsigned char*)malloc(len);
+    if (input == NULL) {
+        STATS_INC(alloc_failures);
+        PyErr_Format(
+            PyExc_SystemError,
+            "Memory allocation failed"
+        );
+        return -1;
+    }
+    memcpy(input, key, key_len);
+    memcpy(input + key_len, ACCEPT_GUID, ACCEPT_GUID_LEN);
+    _sha1(input, len, digest);
+    free(input);
+    _b64_digest(digest, out);
+    return 0;
+}
+
+
+static PyObject * make_accept_key(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    char       *i_key;
+    Py_ssize_t  i_key_len;
+    char        accept[28];
+
+    if (_check_nargs("make_accept_key", nargs, 1, 1) == -1) {
+        return NULL;
+    }
+    if (PyBytes_AsStringAndSize(args[0], &i_key, &i_key_len) == -1) {
+        return NULL;
+    }
+    if (_accept_key(i_key, i_key_len, accept) == -1) {
+        return NULL;
+    }
+    return PyBytes_FromStringAndSize(accept, 28);
+}
+
+
+#define RESPONSE_HEAD \
+    "HTTP/1.1 101 Switching Protocols\r\n" \
+    "Upgrade: websocket\r\n" \
+    "Connection: Upgrade\r\n" \
+    "Sec-WebSocket-Accept: "
+#define RESPONSE_HEAD_LEN    (sizeof(RESPONSE_HEAD) - 1)
+#define RESPONSE_VERSION     "\r\nSec-WebSocket-Version: "
+#define RESPONSE_VERSION_LEN (sizeof(RESPONSE_VERSION) - 1)
+
+static PyObject * make_response_bytes(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    PyObject *o_obj = NULL;
+
+    char       *i_key;
+    Py_ssize_t  i_key_len;
+    char       *i_version = "13";
+    Py_ssize_t  i_version_len = 2;
+    char        accept[28];
+
+    if (_check_nargs("make_response_bytes", nargs, 1, 2) == -1) {
+        goto exit;
+    }
+    if (PyBytes_AsStringAndSize(args[0], &i_key, &i_key_len) == -1) {
+        goto exit;
+    }
+    if (nargs == 2 && PyBytes_AsStringAndSize(args[1], &i_version, &i_version_len) == -1) {
+        goto exit;
+    }
+
+    if (_accept_key(i_key, i_key_len, accept) == -1) {
+        goto exit;
+    }
+
+    o_obj = PyBytes_FromStringAndSize(NULL, RESPONSE_HEAD_LEN + 28 + RESPONSE_VERSION_LEN + i_version_len + 4);
+    if (o_obj == NULL) {
+        goto exit;
+    }
+
+    char *o_data = PyBytes_AS_STRING(o_obj);
+
+    memcpy(o_data, RESPONSE_HEAD, RESPONSE_HEAD_LEN);
+    o_data += RESPONSE_HEAD_LEN;
+    memcpy(o_data, accept, 28);
+    o_data += 28;
+    memcpy(o_data, RESPONSE_VERSION, RESPONSE_VERSION_LEN);
+    o_data += RESPONSE_VERSION_LEN;
+    memcpy(o_data, i_version, i_version_len);
+    o_data += i_version_len;
+    memcpy(o_data, "\r\n\r\n", 4);
+
+exit:
+    return o_obj;
+}
+
+
+// MaskGenerator: hands out 4-byte mask keys from a refilled batch buffer
+
+#define MASK_BATCH_SIZE 256
+
+typedef struct {
+    PyObject_HEAD
+    uint32_t prng[4];
+    uint32_t batch[MASK_BATCH_SIZE];
+    int      batch_pos;
+} MaskGeneratorObject;
+
+
+static PyObject * MaskGenerator_next_mask(MaskGeneratorObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->batch_pos == MASK_BATCH_SIZE) {
+        for (int i = 0; i < MASK_BATCH_SIZE; i++) {
+            self->batch[i] = _xoshiro128_next(self->prng);
+        }
+        self->batch_pos = 0;
+    }
+    return PyBytes_FromStringAndSize((char *)(self->batch + self->batch_pos++), 4);
+}
+
+
+static int MaskGenerator_init(MaskGeneratorObject *self, PyObject *args, PyObject *kwds) {
+    if (!PyArg_ParseTuple(args, "")) {
+        return -1;
+    }
+    if (_xoshiro128_seed(self->prng) == -1) {
+        return -1;
+    }
+    self->batch_pos = MASK_BATCH_SIZE;
+    return 0;
+}
+
+
+static void MaskGenerator_dealloc(MaskGeneratorObject *self) {
+    PyTypeObject *tp = Py_TYPE(self);
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
+}
+
+
+static PyMethodDef MaskGenerator_methods[] = {
+    {
+        "next_mask",
+        (PyCFunction)MaskGenerator_next_mask,
+        METH_NOARGS,
+        "hand out the next 4-byte mask key <- () -> mask",
+    },
+    {NULL, NULL, 0, NULL},
+};
+
+static PyType_Slot MaskGenerator_slots[] = {
+    {Py_tp_doc, (void *)"fast generator for WebSocket mask keys, seeded once from the os <- ()"},
+    {Py_tp_dealloc, (void *)MaskGenerator_dealloc},
+    {Py_tp_methods, (void *)MaskGenerator_methods},
+    {Py_tp_init, (void *)MaskGenerator_init},
+    {Py_tp_new, (void *)PyType_GenericNew},
+    {0, NULL},
+};
+
+static PyType_Spec MaskGenerator_spec = {
+    .name = "_wsframecoder.MaskGenerator",
+    .basicsize = sizeof(MaskGeneratorObject),
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots = MaskGenerator_slots,
+};
+
+
+// DeflateContext: persistent raw deflate/inflate streams for
+// permessage-deflate (RFC 7692) with context takeover across messages.
+// compress strips / decompress re-appends the 0x00 0x00 0xff 0xff tail
+// of a sync flush as the extension specifies.
+
+typedef struct {
+    PyObject_HEAD
+    z_stream deflate_stream;
+    z_stream inflate_stream;
+    int      deflate_initialized;
+    int      inflate_initialized;
+} DeflateContextObject;
+
+static const char _deflate_tail[4] = {0x00, 0x00, (char)0xff, (char)0xff};
+
+
+// grows *buf to hold at least needed bytes, -1 on allocation failure
+static int _zbuf_reserve(char **buf, Py_ssize_t *cap, Py_ssize_t needed) {
+    if (needed <= *cap) {
+        return 0;
+    }
+    Py_ssize_t new_cap = *cap ? *cap : 256;
+    while (new_cap < needed) {
+        new_cap *= 2;
+    }
+    char *new_buf = (char*)realloc(*buf, new_cap);
+    if (new_buf == NULL) {
+        STATS_INC(alloc_failures);
+        PyErr_Format(
+            PyExc_SystemError,
+            "Memory allocation failed"
+        );
+        return -1;
+    }
+    *buf = new_buf;
+    *cap = new_cap;
+    return 0;
+}
+
+
+static PyObject * DeflateContext_compress(DeflateContextObject *self, PyObject *args) {
+    Py_buffer i_buffer;
+
+    if (!PyArg_ParseTuple(args, "y*", &i_buffer)) {
+        return NULL;
+    }
+    if ((uint64_t)i_buffer.len >= UINT_MAX) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid payload: too large"
+        );
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+
+    z_stream *strm = &self->deflate_stream;
+    strm->next_in = (Bytef *)i_buffer.buf;
+    strm->avail_in = (uInt)i_buffer.len;
+
+    char       *out = NULL;
+    Py_ssize_t  out_cap = 0;
+    Py_ssize_t  out_len = 0;
+    PyObject   *o_obj = NULL;
+
+    for (;;) {
+        if (_zbuf_reserve(&out, &out_cap, out_len + 256) == -1) {
+            goto exit;
+        }
+        Py_ssize_t room = out_cap - out_len;
+        strm->next_out = (Bytef *)(out + out_len);
+        strm->avail_out = (uInt)room;
+        int err = deflate(strm, Z_SYNC_FLUSH);
+        if (err != Z_OK && err != Z_BUF_ERROR) {
+            PyErr_Format(
+                PyExc_SystemError,
+                "deflate failed (%d)",
+                err
+            );
+            goto exit;
+        }
+        out_len += room - (Py_ssize_t)strm->avail_out;
+        if (strm->avail_out != 0) {
+            break;
+        }
+    }
+
+    // a sync flush always ends on the empty stored block 00 00 ff ff,
+    // which permessage-deflate omits on the wire
+    if (out_len >= 4 && memcmp(out + out_len - 4, _deflate_tail, 4) == 0) {
+        out_len -= 4;
+    }
+
+    o_obj = PyBytes_FromStringAndSize(out, out_len);
+
+exit:
+    free(out);
+    PyBuffer_Release(&i_buffer);
+    return o_obj;
+}
+
+
+static PyObject * DeflateContext_decompress(DeflateContextObject *self, PyObject *args) {
+    Py_buffer i_buffer;
+
+    if (!PyArg_ParseTuple(args, "y*", &i_buffer)) {
+        return NULL;
+    }
+    if ((uint64_t)i_buffer.len >= UINT_MAX) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid payload: too large"
+        );
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+
+    z_stream *strm = &self->inflate_stream;
+
+    char       *out = NULL;
+    Py_ssize_t  out_cap = 0;
+    Py_ssize_t  out_len = 0;
+    PyObject   *o_obj = NULL;
+
+    // the payload followed by the tail the sender stripped
+    const char *parts[2] = {(const char *)i_buffer.buf, _deflate_tail};
+    Py_ssize_t  part_lens[2] = {i_buffer.len, 4};
+
+    for (int p = 0; p < 2; p++) {
+        strm->next_in = (Bytef *)parts[p];
+        strm->avail_in = (uInt)part_lens[p];
+        do {
+            if (_zbuf_reserve(&out, &out_cap, out_len + 256) == -1) {
+                goto exit;
+            }
+            Py_ssize_t room = out_cap - out_len;
+            strm->next_out = (Bytef *)(out + out_len);
+            strm->avail_out = (uInt)room;
+            int err = inflate(strm, Z_SYNC_FLUSH);
+            if (err != Z_OK && err != Z_BUF_ERROR && err != Z_STREAM_END) {
+                PyErr_Format(
+                    PyExc_ValueError,
+                    "invalid payload: corrupt deflate data (%d)",
+                    err
+                );
+                goto exit;
+            }
+            out_len += room - (Py_ssize_t)strm->avail_out;
+        } while (strm->avail_in != 0);
+    }
+
+    o_obj = PyBytes_FromStringAndSize(out, out_len);
+
+exit:
+    free(out);
+    PyBuffer_Release(&i_buffer);
+    return o_obj;
+}
+
+
+static PyObject * DeflateContext_reset(DeflateContextObject *self, PyObject *Py_UNUSED(ignored)) {
+    // drops the sliding windows of both directions, i.e. the
+    // no-context-takeover behaviour between messages
+    deflateReset(&self->deflate_stream);
+    inflateReset(&self->inflate_stream);
+    Py_RETURN_NONE;
+}
+
+
+static int DeflateContext_init(DeflateContextObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"level", "window_bits", NULL};
+    int i_level = Z_DEFAULT_COMPRESSION;
+    int i_window_bits = 15;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|ii", kwlist, &i_level, &i_window_bits)) {
+        return -1;
+    }
+    if (i_window_bits < 9 || i_window_bits > 15) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid window_bits: not in 9..15"
+        );
+        return -1;
+    }
+
+    if (self->deflate_initialized) {
+        deflateEnd(&self->deflate_stream);
+        self->deflate_initialized = 0;
+    }
+    if (self->inflate_initialized) {
+        inflateEnd(&self->inflate_stream);
+        self->inflate_initialized = 0;
+    }
+    memset(&self->deflate_stream, 0, sizeof(z_stream));
+    memset(&self->inflate_stream, 0, sizeof(z_stream));
+
+    if (deflateInit2(&self->deflate_stream, i_level, Z_DEFLATED, -i_window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        PyErr_Format(
+            PyExc_SystemError,
+            "deflateInit2 failed"
+        );
+        return -1;
+    }
+    self->deflate_initialized = 1;
+
+    if (inflateInit2(&self->inflate_stream, -i_window_bits) != Z_OK) {
+        deflateEnd(&self->deflate_stream);
+        self->deflate_initialized = 0;
+        PyErr_Format(
+            PyExc_SystemError,
+            "inflateInit2 failed"
+        );
+        return -1;
+    }
+    self->inflate_initialized = 1;
+    return 0;
+}
+
+
+static void DeflateContext_dealloc(DeflateContextObject *self) {
+    PyTypeObject *tp = Py_TYPE(self);
+    if (self->deflate_initialized) {
+        deflateEnd(&self->deflate_stream);
+    }
+    if (self->inflate_initialized) {
+        inflateEnd(&self->inflate_stream);
+    }
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
+}
+
+
+static PyMethodDef DeflateContext_methods[] = {
+    {
+        "compress",
+        (PyCFunction)DeflateContext_compress,
+        METH_VARARGS,
+        "compress a message payload for permessage-deflate <- (payload) -> payload (sync flush tail stripped)",
+    },
+    {
+        "decompress",
+        (PyCFunction)DeflateContext_decompress,
+        METH_VARARGS,
+        "decompress a permessage-deflate message payload <- (payload) -> payload",
+    },
+    {
+        "reset",
+        (PyCFunction)DeflateContext_reset,
+        METH_NOARGS,
+        "drop the sliding windows of both directions (no context takeover)",
+    },
+    {NULL, NULL, 0, NULL},
+};
+
+static PyType_Slot DeflateContext_slots[] = {
+    {Py_tp_doc, (void *)"persistent raw deflate/inflate streams for permessage-deflate (RFC 7692) <- (level=-1, window_bits=15)"},
+    {Py_tp_dealloc, (void *)DeflateContext_dealloc},
+    {Py_tp_methods, (void *)DeflateContext_methods},
+    {Py_tp_init, (void *)DeflateContext_init},
+    {Py_tp_new, (void *)PyType_GenericNew},
+    {0, NULL},
+};
+
+static PyType_Spec DeflateContext_spec = {
+    .name = "_wsframecoder.DeflateContext",
+    .basicsize = sizeof(DeflateContextObject),
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots = DeflateContext_slots,
+};
+
+
+// StreamReader: c implemented progressive frame reader.
+// Unconsumed stream data is kept in one internal buffer, feed() consumes
+// chunks of any size and returns the frames completed by them.
+
+#define STREAMREADER_DEMASK_NEVER  0
+#define STREAMREADER_DEMASK_ALWAYS 1
+#define STREAMREADER_DEMASK_AUTO   2
+
+typedef struct {
+    PyObject_HEAD
+    int                demask_mode;
+    char               *buf;
+    Py_ssize_t         buf_len;
+    Py_ssize_t         buf_cap;
+    unsigned long long expected;
+    unsigned long long max_payload_len;
+} StreamReaderObject;
+
+
+static int StreamReader_reserve(StreamReaderObject *self, Py_ssize_t additional) {
+    Py_ssize_t needed = self->buf_len + additional;
+    if (needed <= self->buf_cap) {
+        return 0;
     }
-    
-    o_mask = (char*)malloc(4 * sizeof(char));
-    if (o_mask == NULL) {
+    Py_ssize_t cap = self->buf_cap ? self->buf_cap : 1024;
+    while (cap < needed) {
+        cap *= 2;
+    }
+    char *buf = (char*)realloc(self->buf, cap);
+    if (buf == NULL) {
+        STATS_INC(alloc_failures);
         PyErr_Format(
             PyExc_SystemError,
             "Memory allocation failed"
         );
-        goto exit;
-    };
-    if (masked) {
-        memcpy(o_mask, _input + _header_offset, 4);
-        _header_offset += 4;
+        return -1;
     }
+    self->buf = buf;
+    self->buf_cap = cap;
+    return 0;
+}
 
-    uint64_t _edl = _header_offset + amount;
-    if (_edl != (uint64_t)i_len) {
+
+static PyObject * StreamReader_feed(StreamReaderObject *self, PyObject *args) {
+    STATS_INC(calls_stream_reader_feed);
+    Py_buffer i_buffer;
+
+    if (!PyArg_ParseTuple(args, "y*", &i_buffer)) {
+        return NULL;
+    }
+
+    if (StreamReader_reserve(self, i_buffer.len) == -1) {
+        PyBuffer_Release(&i_buffer);
+        return NULL;
+    }
+    memcpy(self->buf + self->buf_len, i_buffer.buf, i_buffer.len);
+    self->buf_len += i_buffer.len;
+    PyBuffer_Release(&i_buffer);
+
+    PyObject *o_frames = PyList_New(0);
+    if (o_frames == NULL) {
+        return NULL;
+    }
+
+    Py_ssize_t pos = 0;
+
+    for (;;) {
+        Py_ssize_t rem = self->buf_len - pos;
+        if (rem < 2) {
+            self->expected = 2 - rem;
+            break;
+        }
+
+        unsigned char *_input = (unsigned char *)(self->buf + pos);
+
+        char _b1 = _input[0];
+        int      fin         = (_b1 & 0b10000000) >> 7;
+        int      rsv1        = (_b1 & 0b01000000) >> 6;
+        int      rsv2        = (_b1 & 0b00100000) >> 5;
+        int      rsv3        = (_b1 & 0b00010000) >> 4;
+        int      opcode      = (_b1 & 0b00001111);
+        char _b2 = _input[1];
+        int      masked      = (_b2 & 0b10000000) >> 7;
+        int      amount_spec = (_b2 & 0b01111111);
+
+        uint64_t _header_size = 2;
+        if (amount_spec == 126) {
+            _header_size += 2;
+        } else if (amount_spec == 127) {
+            _header_size += 8;
+        }
+        if (masked) {
+            _header_size += 4;
+        }
+
+        if ((uint64_t)rem < _header_size) {
+            self->expected = _header_size - rem;
+            break;
+        }
+
+        uint64_t amount;
+        uint64_t _header_offset = 2;
+        if (amount_spec == 126) {
+            amount =  (uint64_t)_input[2];
+            amount <<= 8;
+            amount |= (uint64_t)_input[3];
+            _header_offset += 2;
+        } else if (amount_spec == 127) {
+            amount =  (uint64_t)_input[2];
+            amount <<= 8;
+            amount |= (uint64_t)_input[3];
+            amount <<= 8;
+            amount |= (uint64_t)_input[4];
+            amount <<= 8;
+            amount |= (uint64_t)_input[5];
+            amount <<= 8;
+            amount |= (uint64_t)_input[6];
+            amount <<= 8;
+            amount |= (uint64_t)_input[7];
+            amount <<= 8;
+            amount |= (uint64_t)_input[8];
+            amount <<= 8;
+            amount |= (uint64_t)_input[9];
+            if (amount >> 63) {
+                // RFC 6455: the most significant bit of the 64-bit length must be 0
+                PyErr_Format(
+                    PyExc_ValueError,
+                    "invalid frame: most significant bit of the 64-bit payload length is set"
+                );
+                goto fail;
+            }
+            _header_offset += 8;
+        } else {
+            amount = amount_spec;
+        }
+
+        if (self->max_payload_len && amount > self->max_payload_len) {
+            // reject before any allocation is sized from the claimed length
+            PyObject *module = PyType_GetModule(Py_TYPE(self));
+            if (module != NULL) {
+                wsframecoder_state *_state = (wsframecoder_state *)PyModule_GetState(module);
+                _raise_payload_too_long(_state->PayloadTooLong, amount, self->max_payload_len);
+            }
+            goto fail;
+        }
+
+        char mask[4] = {0, 0, 0, 0};
+        if (masked) {
+            memcpy(mask, _input + _header_offset, 4);
+        }
+
+        if ((uint64_t)rem < _header_size + amount) {
+            self->expected = _header_size + amount - rem;
+            break;
+        }
+
+        int demask;
+        if (self->demask_mode == STREAMREADER_DEMASK_ALWAYS) {
+            if (!masked) {
+                PyErr_Format(
+                    PyExc_ValueError,
+                    "invalid mask: length != 4"
+                );
+                goto fail;
+            }
+            demask = 1;
+        } else if (self->demask_mode == STREAMREADER_DEMASK_AUTO) {
+            demask = masked;
+        } else {
+            demask = 0;
+        }
+
+        char *_payload = (char *)_input + _header_size;
+
+        PyObject *o_payload = PyBytes_FromStringAndSize(NULL, amount);
+        if (o_payload == NULL) {
+            goto fail;
+        }
+        char *o_payload_data = PyBytes_AS_STRING(o_payload);
+        if ((Py_ssize_t)amount >= NOGIL_THRESHOLD) {
+            Py_BEGIN_ALLOW_THREADS
+            if (demask) {
+                _masking_run(_payload, o_payload_data, amount, mask);
+            } else {
+                memcpy(o_payload_data, _payload, amount);
+            }
+            Py_END_ALLOW_THREADS
+        } else {
+            if (demask) {
+                _masking_run(_payload, o_payload_data, amount, mask);
+            } else {
+                memcpy(o_payload_data, _payload, amount);
+            }
+        }
+
+        PyObject *o_frame = Py_BuildValue(
+            "(i,i,i,i,i,i,i,K,y#,N)",
+            fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, mask, (Py_ssize_t)4, o_payload
+        );
+        if (o_frame == NULL) {
+            goto fail;
+        }
+        int append_failed = PyList_Append(o_frames, o_frame);
+        Py_DECREF(o_frame);
+        if (append_failed) {
+            goto fail;
+        }
+        STATS_INC(frames_parsed);
+
+        pos += _header_size + amount;
+    }
+
+    if (pos) {
+        self->buf_len -= pos;
+        memmove(self->buf, self->buf + pos, self->buf_len);
+    }
+    return o_frames;
+
+fail:
+    if (pos) {
+        self->buf_len -= pos;
+        memmove(self->buf, self->buf + pos, self->buf_len);
+    }
+    if (PyList_GET_SIZE(o_frames) > 0) {
+        // frames completed before the failing one must not be lost:
+        // return them now; the failing frame's bytes stay buffered, so
+        // the next feed hits it first and raises with an empty result
+        PyErr_Clear();
+        return o_frames;
+    }
+    Py_DECREF(o_frames);
+    return NULL;
+}
+
+
+static int StreamReader_init(StreamReaderObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"payloads_masked", "max_payload_len", NULL};
+    PyObject *i_payloads_masked;
+    unsigned long long i_max_payload_len = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|K", kwlist, &i_payloads_masked, &i_max_payload_len)) {
+        return -1;
+    }
+
+    if (PyUnicode_Check(i_payloads_masked) && PyUnicode_CompareWithASCIIString(i_payloads_masked, "auto") == 0) {
+        self->demask_mode = STREAMREADER_DEMASK_AUTO;
+    } else {
+        int truth = PyObject_IsTrue(i_payloads_masked);
+        if (truth == -1) {
+            return -1;
+        }
+        self->demask_mode = truth ? STREAMREADER_DEMASK_ALWAYS : STREAMREADER_DEMASK_NEVER;
+    }
+
+    free(self->buf);
+    self->buf = NULL;
+    self->buf_len = 0;
+    self->buf_cap = 0;
+    self->expected = 2;
+    self->max_payload_len = i_max_payload_len;
+    return 0;
+}
+
+
+static void StreamReader_dealloc(StreamReaderObject *self) {
+    PyTypeObject *tp = Py_TYPE(self);
+    free(self->buf);
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
+}
+
+
+static PyMethodDef StreamReader_methods[] = {
+    {
+        "feed",
+        (PyCFunction)StreamReader_feed,
+        METH_VARARGS,
+        "consume a chunk of stream data of any size <- (data) -> list of completed frames as (fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, mask, payload)",
+    },
+    {NULL, NULL, 0, NULL},
+};
+
+static PyMemberDef StreamReader_members[] = {
+    {"expected", T_ULONGLONG, offsetof(StreamReaderObject, expected), READONLY,
+     "number of bytes missing to complete the next header part or frame"},
+    {NULL, 0, 0, 0, NULL},
+};
+
+static PyType_Slot StreamReader_slots[] = {
+    {Py_tp_doc, (void *)"c implemented progressive WebSocket frame reader <- (payloads_masked: True|False|'auto')"},
+    {Py_tp_dealloc, (void *)StreamReader_dealloc},
+    {Py_tp_methods, (void *)StreamReader_methods},
+    {Py_tp_members, (void *)StreamReader_members},
+    {Py_tp_init, (void *)StreamReader_init},
+    {Py_tp_new, (void *)PyType_GenericNew},
+    {0, NULL},
+};
+
+static PyType_Spec StreamReader_spec = {
+    .name = "_wsframecoder.StreamReader",
+    .basicsize = sizeof(StreamReaderObject),
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots = StreamReader_slots,
+};
+
+
+// RecvBuffer: ingest buffer for socket.recv_into. The writable tail is
+// exported as a memoryview, the parser consumes complete frames out of
+// the front and the remainder is compacted lazily, only when the tail
+// runs out of room. The bytearray backing makes a stale tail view
+// impossible: resizing while a view is exported raises BufferError.
+
+typedef struct {
+    PyObject_HEAD
+    PyObject   *buf;   // bytearray
+    Py_ssize_t  head;  // consumed offset
+    Py_ssize_t  fill;  // filled length
+} RecvBufferObject;
+
+
+static PyObject * RecvBuffer_writable_tail(RecvBufferObject *self, PyObject *args) {
+    Py_ssize_t i_min_size = 2048;
+
+    if (!PyArg_ParseTuple(args, "|n", &i_min_size)) {
+        return NULL;
+    }
+    if (i_min_size < 1) {
         PyErr_Format(
             PyExc_ValueError,
-            "invalid frame: data length (%d) != expected data length (%d)",
-            i_len, _edl
+            "invalid min_size: < 1"
         );
-        goto exit;
+        return NULL;
     }
 
-    if (i_autodemask & masked) {
-        o_masked_payload = _masking((char*)_input + _header_offset, amount, o_mask);
-        if (o_masked_payload == NULL) {
-            goto exit;
+    Py_ssize_t cap = PyByteArray_GET_SIZE(self->buf);
+
+    if (cap - self->fill < i_min_size) {
+        if (self->head) {
+            char *data = PyByteArray_AS_STRING(self->buf);
+            memmove(data, data + self->head, self->fill - self->head);
+            self->fill -= self->head;
+            self->head = 0;
         }
-        o_obj = Py_BuildValue(
-            "(i,i,i,i,i,i,i,i,y#,y#)",
-            fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, o_mask, 4, o_masked_payload, amount
+        if (cap - self->fill < i_min_size) {
+            Py_ssize_t ncap = cap ? cap : 1024;
+            while (ncap - self->fill < i_min_size) {
+                ncap *= 2;
+            }
+            if (PyByteArray_Resize(self->buf, ncap) == -1) {
+                return NULL;
+            }
+        }
+    }
+
+    PyObject *mview = PyMemoryView_FromObject(self->buf);
+    if (mview == NULL) {
+        return NULL;
+    }
+    PyObject *o_tail = _memoryview_slice(mview, self->fill, PyByteArray_GET_SIZE(self->buf));
+    Py_DECREF(mview);
+    return o_tail;
+}
+
+
+static PyObject * RecvBuffer_commit(RecvBufferObject *self, PyObject *args) {
+    Py_ssize_t i_nbytes;
+
+    if (!PyArg_ParseTuple(args, "n", &i_nbytes)) {
+        return NULL;
+    }
+    if (i_nbytes < 0 || i_nbytes > PyByteArray_GET_SIZE(self->buf) - self->fill) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid nbytes: not in [0, %zd]",
+            PyByteArray_GET_SIZE(self->buf) - self->fill
+        );
+        return NULL;
+    }
+    self->fill += i_nbytes;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject * RecvBuffer_read_frames(RecvBufferObject *self, PyObject *args) {
+    STATS_INC(calls_recv_buffer_read_frames);
+    int i_autodemask = 1;
+
+    if (!PyArg_ParseTuple(args, "|p", &i_autodemask)) {
+        return NULL;
+    }
+
+    PyObject *o_frames = PyList_New(0);
+    if (o_frames == NULL) {
+        return NULL;
+    }
+
+    for (;;) {
+        Py_ssize_t rem = self->fill - self->head;
+        if (rem < 2) {
+            break;
+        }
+
+        unsigned char *_input = (unsigned char *)PyByteArray_AS_STRING(self->buf) + self->head;
+
+        char _b1 = _input[0];
+        int      fin         = (_b1 & 0b10000000) >> 7;
+        int      rsv1        = (_b1 & 0b01000000) >> 6;
+        int      rsv2        = (_b1 & 0b00100000) >> 5;
+        int      rsv3        = (_b1 & 0b00010000) >> 4;
+        int      opcode      = (_b1 & 0b00001111);
+        char _b2 = _input[1];
+        int      masked      = (_b2 & 0b10000000) >> 7;
+        int      amount_spec = (_b2 & 0b01111111);
+
+        uint64_t _header_size = 2;
+        if (amount_spec == 126) {
+            _header_size += 2;
+        } else if (amount_spec == 127) {
+            _header_size += 8;
+        }
+        if (masked) {
+            _header_size += 4;
+        }
+
+        if ((uint64_t)rem < _header_size) {
+            break;
+        }
+
+        uint64_t amount;
+        uint64_t _header_offset = 2;
+        if (amount_spec == 126) {
+            amount =  (uint64_t)_input[2];
+            amount <<= 8;
+            amount |= (uint64_t)_input[3];
+            _header_offset += 2;
+        } else if (amount_spec == 127) {
+            amount =  (uint64_t)_input[2];
+            amount <<= 8;
+            amount |= (uint64_t)_input[3];
+            amount <<= 8;
+            amount |= (uint64_t)_input[4];
+            amount <<= 8;
+            amount |= (uint64_t)_input[5];
+            amount <<= 8;
+            amount |= (uint64_t)_input[6];
+            amount <<= 8;
+            amount |= (uint64_t)_input[7];
+            amount <<= 8;
+            amount |= (uint64_t)_input[8];
+            amount <<= 8;
+            amount |= (uint64_t)_input[9];
+            if (amount >> 63) {
+                // RFC 6455: the most significant bit of the 64-bit length must be 0
+                PyErr_Format(
+                    PyExc_ValueError,
+                    "invalid frame: most significant bit of the 64-bit payload length is set"
+                );
+                goto fail;
+            }
+            _header_offset += 8;
+        } else {
+            amount = amount_spec;
+        }
+
+        char mask[4] = {0, 0, 0, 0};
+        if (masked) {
+            memcpy(mask, _input + _header_offset, 4);
+        }
+
+        if ((uint64_t)rem < _header_size + amount) {
+            break;
+        }
+
+        char *_payload = (char *)_input + _header_size;
+        int demask = i_autodemask & masked;
+
+        PyObject *o_payload = PyBytes_FromStringAndSize(NULL, amount);
+        if (o_payload == NULL) {
+            goto fail;
+        }
+        char *o_payload_data = PyBytes_AS_STRING(o_payload);
+        if ((Py_ssize_t)amount >= NOGIL_THRESHOLD) {
+            Py_BEGIN_ALLOW_THREADS
+            if (demask) {
+                _masking_run(_payload, o_payload_data, amount, mask);
+            } else {
+                memcpy(o_payload_data, _payload, amount);
+            }
+            Py_END_ALLOW_THREADS
+        } else {
+            if (demask) {
+                _masking_run(_payload, o_payload_data, amount, mask);
+            } else {
+                memcpy(o_payload_data, _payload, amount);
+            }
+        }
+
+        PyObject *o_frame = Py_BuildValue(
+            "(i,i,i,i,i,i,i,K,y#,N)",
+            fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, mask, (Py_ssize_t)4, o_payload
+        );
+        if (o_frame == NULL) {
+            goto fail;
+        }
+        int append_failed = PyList_Append(o_frames, o_frame);
+        Py_DECREF(o_frame);
+        if (append_failed) {
+            goto fail;
+        }
+        STATS_INC(frames_parsed);
+
+        self->head += _header_size + amount;
+    }
+
+    if (self->head == self->fill) {
+        // everything consumed: reset without a memmove
+        self->head = 0;
+        self->fill = 0;
+    }
+
+    return o_frames;
+
+fail:
+    if (PyList_GET_SIZE(o_frames) > 0) {
+        // same contract as StreamReader.feed: frames completed before
+        // the failing one are returned, the failing frame's bytes stay
+        // buffered and raise on the next call
+        PyErr_Clear();
+        return o_frames;
+    }
+    Py_DECREF(o_frames);
+    return NULL;
+}
+
+
+static PyObject * RecvBuffer_get_pending(RecvBufferObject *self, void *Py_UNUSED(closure)) {
+    return PyLong_FromSsize_t(self->fill - self->head);
+}
+
+
+static int RecvBuffer_init(RecvBufferObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"initial_capacity", NULL};
+    Py_ssize_t i_capacity = 65536;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", kwlist, &i_capacity)) {
+        return -1;
+    }
+    if (i_capacity < 1) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "invalid initial_capacity: < 1"
+        );
+        return -1;
+    }
+
+    PyObject *buf = PyByteArray_FromStringAndSize(NULL, i_capacity);
+    if (buf == NULL) {
+        return -1;
+    }
+    Py_XSETREF(self->buf, buf);
+    self->head = 0;
+    self->fill = 0;
+    return 0;
+}
+
+
+static void RecvBuffer_dealloc(RecvBufferObject *self) {
+    PyTypeObject *tp = Py_TYPE(self);
+    Py_XDECREF(self->buf);
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
+}
+
+
+static PyMethodDef RecvBuffer_methods[] = {
+    {
+        "writable_tail",
+        (PyCFunction)RecvBuffer_writable_tail,
+        METH_VARARGS,
+        "expose the free tail as a writable memoryview for socket.recv_into <- (min_size=2048) -> memoryview",
+    },
+    {
+        "commit",
+        (PyCFunction)RecvBuffer_commit,
+        METH_VARARGS,
+        "mark nbytes of the tail as received <- (nbytes) -> None",
+    },
+    {
+        "read_frames",
+        (PyCFunction)RecvBuffer_read_frames,
+        METH_VARARGS,
+        "parse [and decode] all complete frames out of the buffer <- (auto_demask=True) -> list of frames as (fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, mask, payload)",
+    },
+    {NULL, NULL, 0, NULL},
+};
+
+static PyGetSetDef RecvBuffer_getset[] = {
+    {"pending", (getter)RecvBuffer_get_pending, NULL,
+     "number of received, not yet parsed bytes", NULL},
+    {NULL, NULL, NULL, NULL, NULL},
+};
+
+static PyType_Slot RecvBuffer_slots[] = {
+    {Py_tp_doc, (void *)"ingest buffer for zero-copy reads via socket.recv_into <- (initial_capacity=65536)"},
+    {Py_tp_dealloc, (void *)RecvBuffer_dealloc},
+    {Py_tp_methods, (void *)RecvBuffer_methods},
+    {Py_tp_getset, (void *)RecvBuffer_getset},
+    {Py_tp_init, (void *)RecvBuffer_init},
+    {Py_tp_new, (void *)PyType_GenericNew},
+    {0, NULL},
+};
+
+static PyType_Spec RecvBuffer_spec = {
+    .name = "_wsframecoder.RecvBuffer",
+    .basicsize = sizeof(RecvBufferObject),
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots = RecvBuffer_slots,
+};
+
+
+// FrameParser: callback driven feed interface in the shape of
+// httptools. feed_data consumes an arbitrary chunk entirely in c and
+// invokes on_frame once per completed frame; with on_payload_chunk
+// set, payload bytes are handed out demasked as they arrive and never
+// buffered. Only the at most 14 header bytes are ever copied aside.
+
+#define FRAMEPARSER_PHASE_HEADER        0
+#define FRAMEPARSER_PHASE_CONTINUATION  1
+#define FRAMEPARSER_PHASE_PAYLOAD       2
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *on_frame;
+    PyObject *on_payload_chunk;  // NULL: payloads are buffered
+    unsigned long long max_payload_len;
+
+    int       phase;
+    char      header[14];
+    int       header_len;
+    int       header_need;
+
+    int       fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec;
+    uint64_t  amount;
+    uint64_t  payload_off;
+    char      mask[4];
+
+    char       *buf;
+    Py_ssize_t  buf_len;
+    Py_ssize_t  buf_cap;
+} FrameParserObject;
+
+
+static void _rotate_mask(const char *mask, uint64_t offset, char *out) {
+    out[0] = mask[(offset + 0) & 3];
+    out[1] = mask[(offset + 1) & 3];
+    out[2] = mask[(offset + 2) & 3];
+    out[3] = mask[(offset + 3) & 3];
+}
+
+
+// called with the fixed header complete: decodes the length fields and
+// arms the payload phase; returns -1 on a rejected length
+static int FrameParser_enter_payload(FrameParserObject *self) {
+    unsigned char *_input = (unsigned char *)self->header;
+
+    uint64_t _header_offset = 2;
+
+    if (self->amount_spec == 126) {
+        self->amount =  (uint64_t)_input[2];
+        self->amount <<= 8;
+        self->amount |= (uint64_t)_input[3];
+        _header_offset += 2;
+    } else if (self->amount_spec == 127) {
+        self->amount =  (uint64_t)_input[2];
+        self->amount <<= 8;
+        self->amount |= (uint64_t)_input[3];
+        self->amount <<= 8;
+        self->amount |= (uint64_t)_input[4];
+        self->amount <<= 8;
+        self->amount |= (uint64_t)_input[5];
+        self->amount <<= 8;
+        self->amount |= (uint64_t)_input[6];
+        self->amount <<= 8;
+        self->amount |= (uint64_t)_input[7];
+        self->amount <<= 8;
+        self->amount |= (uint64_t)_input[8];
+        self->amount <<= 8;
+        self->amount |= (uint64_t)_input[9];
+        if (self->amount >> 63) {
+            // RFC 6455: the most significant bit of the 64-bit length must be 0
+            PyErr_Format(
+                PyExc_ValueError,
+                "invalid frame: most significant bit of the 64-bit payload length is set"
+            );
+            return -1;
+        }
+        _header_offset += 8;
+    } else {
+        self->amount = self->amount_spec;
+    }
+
+    if (self->max_payload_len && self->amount > self->max_payload_len) {
+        // reject before any allocation is sized from the claimed length
+        PyObject *module = PyType_GetModule(Py_TYPE(self));
+        if (module != NULL) {
+            wsframecoder_state *_state = (wsframecoder_state *)PyModule_GetState(module);
+            _raise_payload_too_long(_state->PayloadTooLong, self->amount, self->max_payload_len);
+        }
+        return -1;
+    }
+
+    memset(self->mask, 0, 4);
+    if (self->masked) {
+        memcpy(self->mask, _input + _header_offset, 4);
+    }
+
+    self->payload_off = 0;
+    self->buf_len = 0;
+    self->phase = FRAMEPARSER_PHASE_PAYLOAD;
+    return 0;
+}
+
+
+// invokes on_frame for the completed frame; payload is None when the
+// bytes already went out through on_payload_chunk
+static int FrameParser_emit(FrameParserObject *self) {
+    PyObject *o_args;
+    if (self->on_payload_chunk != NULL) {
+        o_args = Py_BuildValue(
+            "((i,i,i,i,i,i,i,K,y#,O))",
+            self->fin, self->rsv1, self->rsv2, self->rsv3, self->opcode, self->masked,
+            self->amount_spec, self->amount, self->mask, (Py_ssize_t)4, Py_None
         );
     } else {
-        o_obj = Py_BuildValue(
-            "(i,i,i,i,i,i,i,i,y#,y#)",
-            fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, o_mask, 4, (char*)_input + _header_offset, amount
+        o_args = Py_BuildValue(
+            "((i,i,i,i,i,i,i,K,y#,y#))",
+            self->fin, self->rsv1, self->rsv2, self->rsv3, self->opcode, self->masked,
+            self->amount_spec, self->amount, self->mask, (Py_ssize_t)4, self->buf, (Py_ssize_t)self->buf_len
         );
     }
+    if (o_args == NULL) {
+        return -1;
+    }
+    PyObject *o_res = PyObject_CallObject(self->on_frame, o_args);
+    Py_DECREF(o_args);
+    if (o_res == NULL) {
+        return -1;
+    }
+    Py_DECREF(o_res);
+    STATS_INC(frames_parsed);
 
-exit:
-    free(o_mask);
-    free(o_masked_payload);
-    return o_obj;
+    self->phase = FRAMEPARSER_PHASE_HEADER;
+    self->header_len = 0;
+    self->header_need = 2;
+    self->buf_len = 0;
+    return 0;
+}
+
+
+static int FrameParser_reserve(FrameParserObject *self, Py_ssize_t additional) {
+    Py_ssize_t needed = self->buf_len + additional;
+    if (needed <= self->buf_cap) {
+        return 0;
+    }
+    Py_ssize_t cap = self->buf_cap ? self->buf_cap : 1024;
+    while (cap < needed) {
+        cap *= 2;
+    }
+    char *buf = (char*)realloc(self->buf, cap);
+    if (buf == NULL) {
+        STATS_INC(alloc_failures);
+        PyErr_Format(
+            PyExc_SystemError,
+            "Memory allocation failed"
+        );
+        return -1;
+    }
+    self->buf = buf;
+    self->buf_cap = cap;
+    return 0;
 }
 
 
+static PyObject * FrameParser_feed_data(FrameParserObject *self, PyObject *args) {
+    STATS_INC(calls_frame_parser_feed_data);
+    Py_buffer i_buffer;
+
+    if (!PyArg_ParseTuple(args, "y*", &i_buffer)) {
+        return NULL;
+    }
+
+    const char *p = (const char *)i_buffer.buf;
+    Py_ssize_t  rem = i_buffer.len;
+
+    while (rem || (self->phase == FRAMEPARSER_PHASE_PAYLOAD && self->payload_off == self->amount)) {
+        if (self->phase == FRAMEPARSER_PHASE_HEADER) {
+            int take = (int)(rem < self->header_need - self->header_len ? rem : self->header_need - self->header_len);
+            memcpy(self->header + self->header_len, p, take);
+            self->header_len += take;
+            p += take;
+            rem -= take;
+            if (self->header_len < self->header_need) {
+                break;
+            }
+
+            char _b1 = self->header[0];
+            self->fin         = (_b1 & 0b10000000) >> 7;
+            self->rsv1        = (_b1 & 0b01000000) >> 6;
+            self->rsv2        = (_b1 & 0b00100000) >> 5;
+            self->rsv3        = (_b1 & 0b00010000) >> 4;
+            self->opcode      = (_b1 & 0b00001111);
+            char _b2 = self->header[1];
+            self->masked      = (_b2 & 0b10000000) >> 7;
+            self->amount_spec = (_b2 & 0b01111111);
+
+            int continuation = 0;
+            if (self->amount_spec == 126) {
+                continuation += 2;
+            } else if (self->amount_spec == 127) {
+                continuation += 8;
+            }
+            if (self->masked) {
+                continuation += 4;
+            }
+
+            if (continuation) {
+                self->header_need = 2 + continuation;
+                self->phase = FRAMEPARSER_PHASE_CONTINUATION;
+            } else if (FrameParser_enter_payload(self) == -1) {
+                goto fail;
+            }
+        } else if (self->phase == FRAMEPARSER_PHASE_CONTINUATION) {
+            int take = (int)(rem < self->header_need - self->header_len ? rem : self->header_need - self->header_len);
+            memcpy(self->header + self->header_len, p, take);
+            self->header_len += take;
+            p += take;
+            rem -= take;
+            if (self->header_len < self->header_need) {
+                break;
+            }
+            if (FrameParser_enter_payload(self) == -1) {
+                goto fail;
+            }
+        } else {
+            Py_ssize_t take = (uint64_t)rem < self->amount - self->payload_off
+                ? rem : (Py_ssize_t)(self->amount - self->payload_off);
 
-static PyObject * read_header(PyObject *self, PyObject *args) {
-    PyObject   *i_obj;
-    Py_ssize_t  i_len;
-    char       *i_data;
+            if (self->on_payload_chunk != NULL) {
+                if (take || self->amount == 0) {
+                    PyObject *o_chunk = PyBytes_FromStringAndSize(NULL, take);
+                    if (o_chunk == NULL) {
+                        goto fail;
+                    }
+                    if (self->masked) {
+                        char rotated[4];
+                        _rotate_mask(self->mask, self->payload_off, rotated);
+                        _masking_run(p, PyBytes_AS_STRING(o_chunk), take, rotated);
+                    } else {
+                        memcpy(PyBytes_AS_STRING(o_chunk), p, take);
+                    }
+                    PyObject *o_res = PyObject_CallFunctionObjArgs(self->on_payload_chunk, o_chunk, NULL);
+                    Py_DECREF(o_chunk);
+                    if (o_res == NULL) {
+                        goto fail;
+                    }
+                    Py_DECREF(o_res);
+                }
+            } else if (take) {
+                if (FrameParser_reserve(self, take) == -1) {
+                    goto fail;
+                }
+                if (self->masked) {
+                    char rotated[4];
+                    _rotate_mask(self->mask, self->payload_off, rotated);
+                    _masking_run(p, self->buf + self->buf_len, take, rotated);
+                } else {
+                    memcpy(self->buf + self->buf_len, p, take);
+                }
+                self->buf_len += take;
+            }
 
-    PyObject *o_obj = NULL;
-    
-    if (!PyArg_ParseTuple(args, "O", &i_obj))
-    {
-        goto exit;
+            p += take;
+            rem -= take;
+            self->payload_off += take;
+
+            if (self->payload_off == self->amount) {
+                if (FrameParser_emit(self) == -1) {
+                    goto fail;
+                }
+            } else {
+                break;
+            }
+        }
     }
 
-    if (PyBytes_AsStringAndSize(i_obj, &i_data, &i_len) == -1) {
-        goto exit;
+    PyBuffer_Release(&i_buffer);
+    Py_RETURN_NONE;
+
+fail:
+    PyBuffer_Release(&i_buffer);
+    return NULL;
+}
+
+
+static int FrameParser_init(FrameParserObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"on_frame", "on_payload_chunk", "max_payload_len", NULL};
+    PyObject *i_on_frame;
+    PyObject *i_on_payload_chunk = Py_None;
+    unsigned long long i_max_payload_len = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OK", kwlist, &i_on_frame, &i_on_payload_chunk, &i_max_payload_len)) {
+        return -1;
     }
-    
-    if ((uint64_t)i_len != 2) {
+    if (!PyCallable_Check(i_on_frame)
+        || (i_on_payload_chunk != Py_None && !PyCallable_Check(i_on_payload_chunk))) {
         PyErr_Format(
-            PyExc_ValueError,
-            "invalid header: data length != 2"
+            PyExc_TypeError,
+            "on_frame and on_payload_chunk must be callable"
         );
-        goto exit;
+        return -1;
     }
-    
-    unsigned char *_input = (unsigned char *)i_data;
-
-    char _b1 = _input[0];
-    int      fin         = (_b1 & 0b10000000) >> 7;
-    int      rsv1        = (_b1 & 0b01000000) >> 6;
-    int      rsv2        = (_b1 & 0b00100000) >> 5;
-    int      rsv3        = (_b1 & 0b00010000) >> 4;
-    int      opcode      = (_b1 & 0b00001111);
-    char _b2 = _input[1];
-    int      masked      = (_b2 & 0b10000000) >> 7;
-    int      amount_spec = (_b2 & 0b01111111);
 
-    int      header_continuation = 0;
-    
-    if (amount_spec == 126) {
-        header_continuation += 2;
-    } else if (amount_spec == 127) {
-        header_continuation += 8;
-    }
-    
-    if (masked) {
-        header_continuation += 4;
+    Py_INCREF(i_on_frame);
+    Py_XSETREF(self->on_frame, i_on_frame);
+    if (i_on_payload_chunk == Py_None) {
+        Py_CLEAR(self->on_payload_chunk);
+    } else {
+        Py_INCREF(i_on_payload_chunk);
+        Py_XSETREF(self->on_payload_chunk, i_on_payload_chunk);
     }
+    self->max_payload_len = i_max_payload_len;
 
-    o_obj = Py_BuildValue(
-        "(i,i,i,i,i,i,i,i)",
-        fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, header_continuation
-    );
+    self->phase = FRAMEPARSER_PHASE_HEADER;
+    self->header_len = 0;
+    self->header_need = 2;
+    free(self->buf);
+    self->buf = NULL;
+    self->buf_len = 0;
+    self->buf_cap = 0;
+    return 0;
+}
 
-exit:
-    return o_obj;
+
+static int FrameParser_traverse(FrameParserObject *self, visitproc visit, void *arg) {
+    Py_VISIT(self->on_frame);
+    Py_VISIT(self->on_payload_chunk);
+    return 0;
 }
 
 
+static int FrameParser_clear(FrameParserObject *self) {
+    Py_CLEAR(self->on_frame);
+    Py_CLEAR(self->on_payload_chunk);
+    return 0;
+}
 
-static PyObject * read_header_continuation(PyObject *self, PyObject *args) {
-    PyObject   *i_obj;
-    Py_ssize_t  i_len;
-    char       *i_data;
-    int         i_amount_spec;
-    int         i_masked;
 
-    char     *o_mask = NULL;
-    PyObject *o_obj = NULL;
-    
-    if (!PyArg_ParseTuple(args, "Oip", &i_obj, &i_amount_spec, &i_masked))
+static void FrameParser_dealloc(FrameParserObject *self) {
+    PyTypeObject *tp = Py_TYPE(self);
+    PyObject_GC_UnTrack(self);
+    FrameParser_clear(self);
+    free(self->buf);
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
+}
+
+
+static PyMethodDef FrameParser_methods[] = {
     {
-        goto exit;
-    }
+        "feed_data",
+        (PyCFunction)FrameParser_feed_data,
+        METH_VARARGS,
+        "consume a chunk of stream data of any size entirely in c <- (data) -> None",
+    },
+    {NULL, NULL, 0, NULL},
+};
 
-    if (PyBytes_AsStringAndSize(i_obj, &i_data, &i_len) == -1) {
-        goto exit;
-    }
+static PyType_Slot FrameParser_slots[] = {
+    {Py_tp_doc, (void *)"callback driven WebSocket frame parser <- (on_frame, on_payload_chunk=None, max_payload_len=0)"},
+    {Py_tp_dealloc, (void *)FrameParser_dealloc},
+    {Py_tp_traverse, (void *)FrameParser_traverse},
+    {Py_tp_clear, (void *)FrameParser_clear},
+    {Py_tp_methods, (void *)FrameParser_methods},
+    {Py_tp_init, (void *)FrameParser_init},
+    {Py_tp_new, (void *)PyType_GenericNew},
+    {0, NULL},
+};
 
-    unsigned char *_input = (unsigned char *)i_data;
+static PyType_Spec FrameParser_spec = {
+    .name = "_wsframecoder.FrameParser",
+    .basicsize = sizeof(FrameParserObject),
+    .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .slots = FrameParser_slots,
+};
 
-    uint64_t _header_size = 0;
-    
-    uint64_t amount;
 
-    // xo
-    if (i_amount_spec == 126) {
-        amount =  (uint64_t)_input[0];
-        amount <<= 8;
-        amount |= (uint64_t)_input[1];
-        _header_size += 2;
-    } else if (i_amount_spec == 127) {
-        amount =  (uint64_t)_input[0];
-        amount <<= 8;
-        amount |= (uint64_t)_input[1];
-        amount <<= 8;
-        amount |= (uint64_t)_input[2];
-        amount <<= 8;
-        amount |= (uint64_t)_input[3];
-        amount <<= 8;
-        amount |= (uint64_t)_input[4];
-        amount <<= 8;
-        amount |= (uint64_t)_input[5];
-        amount <<= 8;
-        amount |= (uint64_t)_input[6];
-        amount <<= 8;
-        amount |= (uint64_t)_input[7];
-        _header_size += 8;
-    } else {
-        amount = i_amount_spec;
+// MessageAssembler: collects the payloads of fragmented messages
+// (fin=0 first fragment, CONTINUE fragments, fin=1 final) in one
+// exponentially grown buffer instead of one object per fragment.
+// The buffer capacity is kept across messages.
+
+typedef struct {
+    PyObject_HEAD
+    char       *buf;
+    Py_ssize_t  buf_len;
+    Py_ssize_t  buf_cap;
+    int         opcode;
+} MessageAssemblerObject;
+
+
+static int MessageAssembler_reserve(MessageAssemblerObject *self, Py_ssize_t additional) {
+    Py_ssize_t needed = self->buf_len + additional;
+    if (needed <= self->buf_cap) {
+        return 0;
     }
-    
-    o_mask = (char*)malloc(4 * sizeof(char));
-    if (o_mask == NULL) {
+    Py_ssize_t cap = self->buf_cap ? self->buf_cap : 1024;
+    while (cap < needed) {
+        cap *= 2;
+    }
+    char *buf = (char*)realloc(self->buf, cap);
+    if (buf == NULL) {
+        STATS_INC(alloc_failures);
         PyErr_Format(
             PyExc_SystemError,
             "Memory allocation failed"
         );
-        goto exit;
-    };
-    if (i_masked) {
-        memcpy(o_mask, _input + _header_size, 4);
-        _header_size += 4;
+        return -1;
     }
+    self->buf = buf;
+    self->buf_cap = cap;
+    return 0;
+}
 
-    if ((uint64_t)i_len != _header_size) {
+
+static PyObject * MessageAssembler_feed(MessageAssemblerObject *self, PyObject *args) {
+    int       i_fin;
+    int       i_opcode;
+    Py_buffer i_payload;
+
+    if (!PyArg_ParseTuple(args, "piy*", &i_fin, &i_opcode, &i_payload)) {
+        return NULL;
+    }
+
+    PyObject *o_obj = NULL;
+
+    if (i_opcode >= 0b00001000) {
         PyErr_Format(
             PyExc_ValueError,
-            "invalid header: data length (%d) != expected data length (%d)",
-            i_len, _header_size
+            "invalid frame: control frame in message assembly"
         );
         goto exit;
     }
-    
-    
-    o_obj = Py_BuildValue(
-        "(y#,i)",
-        o_mask, 4, amount
-    );
+
+    if (i_opcode) {
+        // first (or only) fragment of a message
+        if (self->opcode != -1) {
+            PyErr_Format(
+                PyExc_ValueError,
+                "invalid frame: new message before final fragment"
+            );
+            goto exit;
+        }
+        if (i_fin) {
+            // not fragmented: hand the payload through without buffering
+            o_obj = Py_BuildValue(
+                "(i,y#)",
+                i_opcode, (char *)i_payload.buf, i_payload.len
+            );
+            goto exit;
+        }
+        self->opcode = i_opcode;
+    } else {
+        if (self->opcode == -1) {
+            PyErr_Format(
+                PyExc_ValueError,
+                "invalid frame: continuation without start"
+            );
+            goto exit;
+        }
+    }
+
+    if (MessageAssembler_reserve(self, i_payload.len) == -1) {
+        goto exit;
+    }
+    if (i_payload.len >= NOGIL_THRESHOLD) {
+        char       *_dst = self->buf + self->buf_len;
+        char       *_src = (char *)i_payload.buf;
+        Py_ssize_t  _len = i_payload.len;
+        Py_BEGIN_ALLOW_THREADS
+        memcpy(_dst, _src, _len);
+        Py_END_ALLOW_THREADS
+    } else {
+        memcpy(self->buf + self->buf_len, i_payload.buf, i_payload.len);
+    }
+    self->buf_len += i_payload.len;
+
+    if (i_fin) {
+        o_obj = Py_BuildValue(
+            "(i,y#)",
+            self->opcode, self->buf, self->buf_len
+        );
+        self->opcode = -1;
+        self->buf_len = 0;
+    } else {
+        o_obj = Py_None;
+        Py_INCREF(o_obj);
+    }
 
 exit:
-    free(o_mask);
+    PyBuffer_Release(&i_payload);
     return o_obj;
 }
 
 
+static PyObject * MessageAssembler_reset(MessageAssemblerObject *self, PyObject *Py_UNUSED(ignored)) {
+    self->opcode = -1;
+    self->buf_len = 0;
+    Py_RETURN_NONE;
+}
+
+
+static int MessageAssembler_init(MessageAssemblerObject *self, PyObject *args, PyObject *kwds) {
+    if (!PyArg_ParseTuple(args, "")) {
+        return -1;
+    }
+    free(self->buf);
+    self->buf = NULL;
+    self->buf_len = 0;
+    self->buf_cap = 0;
+    self->opcode = -1;
+    return 0;
+}
+
+
+static void MessageAssembler_dealloc(MessageAssemblerObject *self) {
+    PyTypeObject *tp = Py_TYPE(self);
+    free(self->buf);
+    tp->tp_free((PyObject *)self);
+    Py_DECREF(tp);
+}
+
+
+static PyMethodDef MessageAssembler_methods[] = {
+    {
+        "feed",
+        (PyCFunction)MessageAssembler_feed,
+        METH_VARARGS,
+        "consume one data frame of a message <- (fin, opcode, payload) -> (opcode, payload) when the message is complete, else None",
+    },
+    {
+        "reset",
+        (PyCFunction)MessageAssembler_reset,
+        METH_NOARGS,
+        "discard a partially assembled message",
+    },
+    {NULL, NULL, 0, NULL},
+};
+
+static PyMemberDef MessageAssembler_members[] = {
+    {"opcode", T_INT, offsetof(MessageAssemblerObject, opcode), READONLY,
+     "opcode of the message currently being assembled, -1 if idle"},
+    {NULL, 0, 0, 0, NULL},
+};
+
+static PyType_Slot MessageAssembler_slots[] = {
+    {Py_tp_doc, (void *)"c implemented assembler for fragmented WebSocket messages <- ()"},
+    {Py_tp_dealloc, (void *)MessageAssembler_dealloc},
+    {Py_tp_methods, (void *)MessageAssembler_methods},
+    {Py_tp_members, (void *)MessageAssembler_members},
+    {Py_tp_init, (void *)MessageAssembler_init},
+    {Py_tp_new, (void *)PyType_GenericNew},
+    {0, NULL},
+};
+
+static PyType_Spec MessageAssembler_spec = {
+    .name = "_wsframecoder.MessageAssembler",
+    .basicsize = sizeof(MessageAssemblerObject),
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots = MessageAssembler_slots,
+};
+
 
 static PyMethodDef wsframecoder_meth[] = {
     {
         "read_header",
-        (PyCFunction)read_header,
-        METH_VARARGS,
+        (PyCFunction)(void(*)(void))read_header,
+        METH_FASTCALL,
         "read a WebSocket header <- (<two-bytes>) -> (fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, header_continuation)",
     },
     {
         "read_header_continuation",
-        (PyCFunction)read_header_continuation,
-        METH_VARARGS,
+        (PyCFunction)(void(*)(void))read_header_continuation,
+        METH_FASTCALL,
         "read a WebSocket header continuation <- (<header-continuation-bytes>, amount_spec, masked) -> (mask, amount)",
     },
     {
         "parse",
-        (PyCFunction)parse,
-        METH_VARARGS,
+        (PyCFunction)(void(*)(void))parse,
+        METH_FASTCALL,
         "parse [and decode] a WebSocket frame <- (streamdata, auto_demask) -> (fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, mask, payload)",
     },
+    {
+        "parse_all",
+        (PyCFunction)(void(*)(void))parse_all,
+        METH_FASTCALL,
+        "parse [and decode] all complete WebSocket frames in a buffer <- (streamdata, auto_demask) -> ([(fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, mask, payload), ...], leftover)",
+    },
+    {
+        "parse_frame",
+        (PyCFunction)(void(*)(void))parse_frame,
+        METH_FASTCALL,
+        "parse [and decode] a WebSocket frame into a Frame struct sequence <- (streamdata, auto_demask, validate_utf8=False) -> Frame",
+    },
+    {
+        "parse_partial",
+        (PyCFunction)(void(*)(void))parse_partial,
+        METH_FASTCALL,
+        "parse [and decode] one WebSocket frame starting at an offset <- (buffer, offset, auto_demask) -> (frame, consumed) | (None, needed)",
+    },
+    {
+        "parse_into",
+        (PyCFunction)(void(*)(void))parse_into,
+        METH_FASTCALL,
+        "parse [and decode] a WebSocket frame, writing the payload into a writable buffer <- (streamdata, auto_demask, buffer) -> (fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, mask)",
+    },
+    {
+        "parse_view",
+        (PyCFunction)(void(*)(void))parse_view,
+        METH_FASTCALL,
+        "parse a WebSocket frame without copying, mask and payload are memoryview slices into the input <- (streamdata) -> (fin, rsv1, rsv2, rsv3, opcode, masked, amount_spec, amount, mask, payload)",
+    },
     {
         "build",
-        (PyCFunction)build,
-        METH_VARARGS,
+        (PyCFunction)(void(*)(void))build,
+        METH_FASTCALL,
         "create a WebSocket frame <- (fin, rsv1, rsv2, rsv3, opcode, mask, payload) -> streamdata",
     },
+    {
+        "build_into",
+        (PyCFunction)(void(*)(void))build_into,
+        METH_FASTCALL,
+        "create a WebSocket frame into a writable buffer <- (fin, rsv1, rsv2, rsv3, opcode, mask, payload, buffer) -> bytes written",
+    },
+    {
+        "build_many",
+        (PyCFunction)(void(*)(void))build_many,
+        METH_FASTCALL,
+        "create many WebSocket frames back-to-back in one buffer <- ([(fin, rsv1, rsv2, rsv3, opcode, mask, payload), ...]) -> streamdata",
+    },
+    {
+        "build_many_into",
+        (PyCFunction)(void(*)(void))build_many_into,
+        METH_FASTCALL,
+        "create many WebSocket frames back-to-back into a writable buffer <- ([(fin, rsv1, rsv2, rsv3, opcode, mask, payload), ...], buffer) -> bytes written",
+    },
+    {
+        "build_header",
+        (PyCFunction)(void(*)(void))build_header,
+        METH_FASTCALL,
+        "create only the header of a WebSocket frame <- (fin, rsv1, rsv2, rsv3, opcode, mask, payload_len) -> header bytes",
+    },
+    {
+        "build_file_header",
+        (PyCFunction)(void(*)(void))build_file_header,
+        METH_FASTCALL,
+        "create the header for a file region to be sent via os.sendfile <- (fd_or_path, offset, length, opcode=BINARY, fin=1) -> header bytes",
+    },
     {
         "masking",
-        (PyCFunction)masking,
-        METH_VARARGS,
+        (PyCFunction)(void(*)(void))masking,
+        METH_FASTCALL,
         "apply masking to a WebSocket payload <- (payload, mask) -> payload",
     },
+    {
+        "validate_utf8",
+        (PyCFunction)(void(*)(void))validate_utf8,
+        METH_FASTCALL,
+        "check that a buffer contains valid utf-8 <- (buffer) -> bool",
+    },
+    {
+        "masking_inplace",
+        (PyCFunction)(void(*)(void))masking_inplace,
+        METH_FASTCALL,
+        "apply masking to a writable WebSocket payload buffer in place <- (buffer, mask) -> None",
+    },
+    {
+        "set_parallel_masking",
+        (PyCFunction)(void(*)(void))set_parallel_masking,
+        METH_FASTCALL,
+        "split masking of payloads >= threshold across worker threads <- (workers, threshold=4194304) -> None",
+    },
+    {
+        "masking_backend",
+        (PyCFunction)(void(*)(void))masking_backend,
+        METH_FASTCALL,
+        "name of the active masking kernel <- () -> 'avx512f' | 'avx2' | 'sse2' | 'neon' | 'scalar64'",
+    },
+    {
+        "get_stats",
+        (PyCFunction)(void(*)(void))get_stats,
+        METH_FASTCALL,
+        "snapshot of the hot-path counters <- () -> dict",
+    },
+    {
+        "reset_stats",
+        (PyCFunction)(void(*)(void))reset_stats,
+        METH_FASTCALL,
+        "zero all hot-path counters <- () -> None",
+    },
+    {
+        "masking_offset",
+        (PyCFunction)(void(*)(void))masking_offset,
+        METH_FASTCALL,
+        "apply masking to a WebSocket payload chunk starting at any mask offset <- (payload, mask, start_offset) -> payload",
+    },
+    {
+        "parse_http_headers",
+        (PyCFunction)(void(*)(void))parse_http_headers,
+        METH_FASTCALL,
+        "parse a http header block in one pass <- (streamdata) -> (l1, [(key, value), ...])",
+    },
+    {
+        "build_http_headers",
+        (PyCFunction)(void(*)(void))build_http_headers,
+        METH_FASTCALL,
+        "serialize a http header block in one pass <- (l1, [(key, value), ...]) -> streamdata",
+    },
+    {
+        "make_accept_key",
+        (PyCFunction)(void(*)(void))make_accept_key,
+        METH_FASTCALL,
+        "compute the Sec-WebSocket-Accept value (sha1 + base64) in one call <- (b64key) -> accept",
+    },
+    {
+        "make_response_bytes",
+        (PyCFunction)(void(*)(void))make_response_bytes,
+        METH_FASTCALL,
+        "emit the complete 101 handshake response from a template <- (b64key, version=b\"13\") -> streamdata",
+    },
     {NULL, NULL, 0, NULL},
 };
 
+static int wsframecoder_add_type(PyObject *module, const char *name, PyType_Spec *spec, PyObject **slot) {
+    PyObject *type = PyType_FromModuleAndSpec(module, spec, NULL);
+    if (type == NULL) {
+        return -1;
+    }
+    Py_INCREF(type);
+    if (PyModule_AddObject(module, name, type) < 0) {
+        Py_DECREF(type);
+        Py_DECREF(type);
+        return -1;
+    }
+    *slot = type;
+    return 0;
+}
+
+
+static int wsframecoder_exec(PyObject *module) {
+#if MASKING_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        _masking_kernel = _masking_kernel_avx512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        _masking_kernel = _masking_kernel_avx2;
+    }
+#endif
+    wsframecoder_state *state = (wsframecoder_state *)PyModule_GetState(module);
+    if (wsframecoder_add_type(module, "StreamReader", &StreamReader_spec, &state->StreamReaderType) < 0) {
+        return -1;
+    }
+    if (wsframecoder_add_type(module, "DeflateContext", &DeflateContext_spec, &state->DeflateContextType) < 0) {
+        return -1;
+    }
+    if (wsframecoder_add_type(module, "MessageAssembler", &MessageAssembler_spec, &state->MessageAssemblerType) < 0) {
+        return -1;
+    }
+    if (wsframecoder_add_type(module, "MaskGenerator", &MaskGenerator_spec, &state->MaskGeneratorType) < 0) {
+        return -1;
+    }
+    if (wsframecoder_add_type(module, "RecvBuffer", &RecvBuffer_spec, &state->RecvBufferType) < 0) {
+        return -1;
+    }
+    if (wsframecoder_add_type(module, "FrameParser", &FrameParser_spec, &state->FrameParserType) < 0) {
+        return -1;
+    }
+    PyTypeObject *frame_type = PyStructSequence_NewType(&Frame_desc);
+    if (frame_type == NULL) {
+        return -1;
+    }
+    state->FrameType = (PyObject *)frame_type;
+    Py_INCREF(frame_type);
+    if (PyModule_AddObject(module, "Frame", (PyObject *)frame_type) < 0) {
+        Py_DECREF(frame_type);
+        Py_CLEAR(state->FrameType);
+        return -1;
+    }
+    if (_xoshiro128_seed(state->auto_mask_prng) == -1) {
+        return -1;
+    }
+    state->PayloadTooLong = PyErr_NewExceptionWithDoc(
+        "_wsframecoder.PayloadTooLong",
+        "a frame claims a payload length above max_payload_len; args are (message, claimed_length)",
+        PyExc_ValueError,
+        NULL
+    );
+    if (state->PayloadTooLong == NULL) {
+        return -1;
+    }
+    Py_INCREF(state->PayloadTooLong);
+    if (PyModule_AddObject(module, "PayloadTooLong", state->PayloadTooLong) < 0) {
+        Py_DECREF(state->PayloadTooLong);
+        Py_CLEAR(state->PayloadTooLong);
+        return -1;
+    }
+    state->AutoMask = PyObject_CallObject((PyObject *)&PyBaseObject_Type, NULL);
+    if (state->AutoMask == NULL) {
+        return -1;
+    }
+    Py_INCREF(state->AutoMask);
+    if (PyModule_AddObject(module, "AUTO", state->AutoMask) < 0) {
+        Py_DECREF(state->AutoMask);
+        Py_CLEAR(state->AutoMask);
+        return -1;
+    }
+    return 0;
+}
+
+
+static int wsframecoder_traverse(PyObject *module, visitproc visit, void *arg) {
+    wsframecoder_state *state = (wsframecoder_state *)PyModule_GetState(module);
+    Py_VISIT(state->StreamReaderType);
+    Py_VISIT(state->DeflateContextType);
+    Py_VISIT(state->MessageAssemblerType);
+    Py_VISIT(state->MaskGeneratorType);
+    Py_VISIT(state->RecvBufferType);
+    Py_VISIT(state->FrameParserType);
+    Py_VISIT(state->FrameType);
+    Py_VISIT(state->PayloadTooLong);
+    Py_VISIT(state->AutoMask);
+    return 0;
+}
+
+
+static int wsframecoder_clear(PyObject *module) {
+    wsframecoder_state *state = (wsframecoder_state *)PyModule_GetState(module);
+    Py_CLEAR(state->StreamReaderType);
+    Py_CLEAR(state->DeflateContextType);
+    Py_CLEAR(state->MessageAssemblerType);
+    Py_CLEAR(state->MaskGeneratorType);
+    Py_CLEAR(state->RecvBufferType);
+    Py_CLEAR(state->FrameParserType);
+    Py_CLEAR(state->FrameType);
+    Py_CLEAR(state->PayloadTooLong);
+    Py_CLEAR(state->AutoMask);
+    return 0;
+}
+
+
+static PyModuleDef_Slot wsframecoder_slots[] = {
+    {Py_mod_exec, wsframecoder_exec},
+#ifdef Py_mod_multiple_interpreters
+    {Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+    // no Py_MOD_GIL_NOT_USED: the heap types and the process-wide
+    // masking/statistics globals carry no per-object locking, and the
+    // feed paths release the GIL with pointers into their buffers live;
+    // on free-threaded builds the interpreter keeps the GIL enabled
+    {0, NULL},
+};
+
 static struct PyModuleDef wsframecoder_mod = {
     PyModuleDef_HEAD_INIT,
     "_wsframecoder",
     "c implemented coders for WebSocket frames",
-    -1,
+    sizeof(wsframecoder_state),
     wsframecoder_meth,
-    NULL,
-    NULL,
-    NULL,
+    wsframecoder_slots,
+    wsframecoder_traverse,
+    wsframecoder_clear,
     NULL
 };
 
 PyMODINIT_FUNC
 PyInit__wsframecoder(void) {
-    return PyModule_Create(&wsframecoder_mod);
+    return PyModuleDef_Init(&wsframecoder_mod);
 }
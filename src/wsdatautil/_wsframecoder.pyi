@@ -1,13 +1,252 @@
-from typing import Literal
+from typing import Callable, Literal
+
+
+AUTO: object
+"""sentinel accepted as `mask` by ``build``: generate a fresh mask key in c"""
+
+
+class PayloadTooLong(ValueError):
+    """
+    a frame claims a payload length above `max_payload_len`; raised
+    before any allocation is sized from the claimed length
+
+    ``args`` are ``(message, claimed_length)``
+    """
+
+
+class MaskGenerator:
+    """
+    fast generator for WebSocket mask keys
+
+    a xoshiro128** prng is seeded once from the os; keys are handed out
+    from a refilled batch buffer without further syscalls
+    """
+
+    def __init__(self): ...
+
+    def next_mask(self) -> bytes:
+        """
+        hand out the next 4-byte mask key
+        """
+        ...
+
+
+class Frame(tuple):
+    """
+    WebSocket frame parsed in c: a struct sequence with the field names
+    and order of ``wsdatautil.Frame``, so both compare and unpack as the
+    same tuple (the coding methods are attached by the package)
+    """
+
+    payload: bytes
+    opcode: int
+    mask: bytes | None
+    fin: int
+    rsv1: int
+    rsv2: int
+    rsv3: int
+    amount_spec: int
+    amount: int
+
+
+class RecvBuffer:
+    """
+    ingest buffer for zero-copy reads via ``socket.recv_into``
+
+    received bytes land directly in the internal buffer through the
+    exported tail view; complete frames are parsed out of the front and
+    the remainder is compacted lazily
+    """
+
+    pending: int
+    """number of received, not yet parsed bytes"""
+
+    def __init__(self, initial_capacity: int = 65536): ...
+
+    def writable_tail(self, min_size: int = 2048, /) -> memoryview:
+        """
+        expose the free tail of the buffer as a writable memoryview of at
+        least `min_size` bytes (compacting or growing first if needed),
+        to be passed to ``socket.recv_into`` and discarded afterwards
+        """
+        ...
+
+    def commit(self, nbytes: int, /) -> None:
+        """
+        mark `nbytes` of the tail as received (the return value of
+        ``socket.recv_into``)
+        """
+        ...
+
+    def read_frames(
+            self,
+            auto_demask: bool = True,
+            /
+    ) -> list[tuple[int, int, int, int, int, int, int, int, bytes, bytes]]:
+        """
+        parse [and decode] all complete frames out of the buffer
+
+        returns: list of frames as returned by ``parse``; a trailing
+        partial frame stays buffered for the next read
+        """
+        ...
+
+
+class FrameParser:
+    """
+    callback driven frame parser in the shape of ``httptools``
+
+    ``feed_data`` consumes a chunk of any size entirely in c and invokes
+    `on_frame` once per completed frame with the tuple layout of
+    ``parse`` (payloads demasked); with `on_payload_chunk` set, payload
+    bytes are handed out as they arrive instead of being buffered and
+    the payload field of the frame tuple is None
+    """
+
+    def __init__(
+            self,
+            on_frame: Callable[[tuple[int, int, int, int, int, int, int, int, bytes, bytes | None]], object],
+            on_payload_chunk: Callable[[bytes], object] | None = None,
+            max_payload_len: int = 0,
+    ): ...
+
+    def feed_data(self, data: bytes, /) -> None:
+        """consume a chunk of stream data of any size"""
+        ...
+
+
+class DeflateContext:
+    """
+    persistent raw deflate/inflate streams for permessage-deflate
+    (RFC 7692) with context takeover across messages
+    """
+
+    def __init__(self, level: int = -1, window_bits: int = 15): ...
+
+    def compress(
+            self,
+            payload: bytes | bytearray | memoryview,
+            /
+    ) -> bytes:
+        """
+        compress a message payload (the 0x00 0x00 0xff 0xff sync flush
+        tail is stripped as the extension specifies)
+        """
+        ...
+
+    def decompress(
+            self,
+            payload: bytes | bytearray | memoryview,
+            /
+    ) -> bytes:
+        """
+        decompress a message payload (the stripped sync flush tail is
+        re-appended internally)
+        """
+        ...
+
+    def reset(self) -> None:
+        """
+        drop the sliding windows of both directions (no context takeover)
+        """
+        ...
+
+
+class MessageAssembler:
+    """
+    c implemented assembler for fragmented WebSocket messages
+
+    payloads are collected in one exponentially grown buffer whose
+    capacity is kept across messages
+    """
+
+    opcode: int
+    """opcode of the message currently being assembled, -1 if idle"""
+
+    def __init__(self): ...
+
+    def feed(
+            self,
+            fin: Literal[0, 1] | int,
+            opcode: int,
+            payload: bytes | bytearray | memoryview,
+            /
+    ) -> tuple[int, bytes] | None:
+        """
+        consume one data frame of a message
+
+        returns: (opcode, payload) of the whole message when complete,
+        else None; control frames raise a ValueError
+        """
+        ...
+
+    def reset(self) -> None:
+        """
+        discard a partially assembled message
+        """
+        ...
+
+
+class StreamReader:
+    """
+    c implemented progressive WebSocket frame reader
+
+    buffers incomplete stream data internally; ``feed`` accepts
+    chunks of any size
+    """
+
+    expected: int
+    """number of bytes missing to complete the next header part or frame"""
+
+    def __init__(self, payloads_masked: bool | Literal["auto"], max_payload_len: int = 0):
+        """
+        if `max_payload_len` is non-zero, a frame claiming a longer
+        payload raises ``PayloadTooLong`` from ``feed`` before any
+        allocation (0 = unlimited)
+        """
+        ...
+
+    def feed(
+            self,
+            data: bytes | bytearray | memoryview,
+            /
+    ) -> list[tuple[int, int, int, int, int, int, int, int, bytes, bytes]]:
+        """
+        consume a chunk of stream data of any size
+
+        returns: list of completed frames as (
+            - fin: 0|1,
+            - rsv1: 0|1,
+            - rsv2: 0|1,
+            - rsv3: 0|1,
+            - opcode: int,
+            - masked: 0|1,
+            - amount_spec: int,
+            - amount: int,
+            - mask: 4 bytes,
+            - masked/de-masked payload: bytes
+        )
+        """
+        ...
 
 
 def parse(
         streamdata: bytes,
-        auto_demask: bool
+        auto_demask: bool,
+        validate_utf8: bool = False,
+        max_payload_len: int = 0,
+        /
 ) -> tuple[int, int, int, int, int, int, int, int, bytes, bytes]:
     """
     parse [and decode] a WebSocket frame
 
+    if `validate_utf8` is set, the payload of a final TEXT frame is
+    checked during the parse and a ValueError is raised if it is not
+    valid utf-8
+
+    if `max_payload_len` is non-zero, a frame claiming a longer payload
+    raises ``PayloadTooLong`` before any allocation (0 = unlimited)
+
     returns: (
         - fin: 0|1,
         - rsv1: 0|1,
@@ -23,14 +262,114 @@ def parse(
     """
     ...
 
+def parse_into(
+        streamdata: bytes,
+        auto_demask: bool,
+        buffer: bytearray | memoryview,
+        /
+) -> tuple[int, int, int, int, int, int, int, int, bytes]:
+    """
+    parse [and decode] a WebSocket frame, writing the payload into a
+    caller provided writable buffer (e.g. a recycled bytearray)
+
+    returns: the tuple of ``parse`` without the payload field; `amount`
+    is the number of payload bytes written to `buffer`
+    """
+    ...
+
+def parse_all(
+        streamdata: bytes | bytearray | memoryview,
+        auto_demask: bool,
+        max_payload_len: int = 0,
+        /
+) -> tuple[list[tuple[int, int, int, int, int, int, int, int, bytes, bytes]], int]:
+    """
+    parse [and decode] all complete WebSocket frames in a buffer
+
+    a trailing partial frame is not an error, its bytes are reported
+    as leftover instead
+
+    if `max_payload_len` is non-zero, a frame claiming a longer payload
+    raises ``PayloadTooLong`` before any allocation (0 = unlimited)
+
+    returns: (
+        - frames: list of tuples as returned by ``parse``,
+        - leftover: number of unconsumed trailing bytes
+    )
+    """
+    ...
+
+def parse_frame(
+        streamdata: bytes,
+        auto_demask: bool,
+        validate_utf8: bool = False,
+        max_payload_len: int = 0,
+        /
+) -> Frame:
+    """
+    parse [and decode] a WebSocket frame directly into a ``Frame``
+    struct sequence, skipping the tuple-unpack-and-reconstruct step in
+    python (`mask` is None if the frame is not masked)
+
+    if `max_payload_len` is non-zero, a frame claiming a longer payload
+    raises ``PayloadTooLong`` before any allocation (0 = unlimited)
+    """
+    ...
+
+
+def parse_partial(
+        buffer: bytes | bytearray | memoryview,
+        offset: int,
+        auto_demask: bool,
+        /
+) -> tuple[tuple[int, int, int, int, int, int, int, int, bytes, bytes], int] | tuple[None, int]:
+    """
+    parse [and decode] one WebSocket frame starting at `offset`, without
+    requiring the buffer to end with the frame
+
+    returns: (frame, consumed) on success, where frame is the tuple of
+    ``parse`` and consumed the number of bytes the frame occupied; or
+    (None, needed) when the frame is incomplete, where needed is the
+    number of bytes missing to complete the next header part or frame
+    """
+    ...
+
+
+def parse_view(
+        streamdata: bytes | bytearray | memoryview,
+        /
+) -> tuple[int, int, int, int, int, int, int, int, memoryview, memoryview]:
+    """
+    parse a WebSocket frame without copying the payload
+
+    `mask` and `payload` are returned as memoryview slices into the
+    input buffer (the payload is never demasked); `mask` is an empty
+    view if the frame is not masked
+
+    returns: (
+        - fin: 0|1,
+        - rsv1: 0|1,
+        - rsv2: 0|1,
+        - rsv3: 0|1,
+        - opcode: int,
+        - masked: 0|1,
+        - amount_spec: int,
+        - amount: int,
+        - mask: memoryview (4 or 0 bytes),
+        - payload: memoryview
+    )
+    """
+    ...
+
 def build(
         fin: Literal[0, 1] | int,
         rsv1: Literal[0, 1] | int,
         rsv2: Literal[0, 1] | int,
         rsv3: Literal[0, 1] | int,
         opcode: Literal[1, 2, 8, 9, 10] | int,
-        mask: bytes,
+        mask: bytes | object,
         payload: bytes,
+        validate_utf8: bool = False,
         /
 ) -> bytes:
     """
@@ -41,11 +380,154 @@ def build(
     - rsv2: 0|1
     - rsv3: 0|1
     - opcode: int
-    - mask: empty or 4 bytes
+    - mask: empty or 4 bytes, or ``AUTO`` to generate a fresh key in c
     - payload: bytes
+    - validate_utf8: check the payload of a final TEXT frame and raise
+      a ValueError if it is not valid utf-8
+    """
+    ...
+
+def validate_utf8(
+        buffer: bytes | bytearray | memoryview,
+        /
+) -> bool:
+    """
+    check that a buffer contains valid utf-8
     """
     ...
 
+def build_into(
+        fin: Literal[0, 1] | int,
+        rsv1: Literal[0, 1] | int,
+        rsv2: Literal[0, 1] | int,
+        rsv3: Literal[0, 1] | int,
+        opcode: Literal[1, 2, 8, 9, 10] | int,
+        mask: bytes,
+        payload: bytes,
+        buffer: bytearray | memoryview,
+        /
+) -> int:
+    """
+    create a WebSocket frame into a caller provided writable buffer
+    (e.g. a recycled bytearray), must be large enough
+
+    returns: the number of bytes written
+    """
+    ...
+
+def build_many(
+        frames: list[tuple[int, int, int, int, int, bytes, bytes]],
+        /
+) -> bytes:
+    """
+    create many WebSocket frames back-to-back in one buffer
+
+    - frames: sequence of (fin, rsv1, rsv2, rsv3, opcode, mask, payload)
+      tuples as accepted by ``build``
+    """
+    ...
+
+def build_many_into(
+        frames: list[tuple[int, int, int, int, int, bytes, bytes]],
+        buffer: bytearray | memoryview,
+        /
+) -> int:
+    """
+    create many WebSocket frames back-to-back into a writable buffer
+
+    - frames: sequence of (fin, rsv1, rsv2, rsv3, opcode, mask, payload)
+      tuples as accepted by ``build``
+    - buffer: writable buffer, must be large enough
+
+    returns: the number of bytes written
+    """
+    ...
+
+def build_header(
+        fin: Literal[0, 1] | int,
+        rsv1: Literal[0, 1] | int,
+        rsv2: Literal[0, 1] | int,
+        rsv3: Literal[0, 1] | int,
+        opcode: Literal[1, 2, 8, 9, 10] | int,
+        mask: bytes,
+        payload_len: int,
+        /
+) -> bytes:
+    """
+    create only the 2-14 header bytes of a WebSocket frame
+
+    - fin: 0|1
+    - rsv1: 0|1
+    - rsv2: 0|1
+    - rsv3: 0|1
+    - opcode: int
+    - mask: empty or 4 bytes (included in the header when set)
+    - payload_len: length of the payload the header announces
+    """
+    ...
+
+def set_parallel_masking(
+        workers: int,
+        threshold: int = 4194304,
+        /
+) -> None:
+    """
+    opt in to parallel masking: payloads of at least `threshold` bytes
+    are split across `workers` threads (gil released), each handling a
+    64-byte-aligned slice; a single kernel pass is memory-bandwidth-bound
+    on one core, so this helps for multi-megabyte frames
+
+    - workers: 0 or 1 disables the parallel path (the default)
+    - threshold: minimum payload size in bytes
+
+    affects all masking call sites of the module process-wide
+    """
+    ...
+
+
+def masking_backend() -> Literal["avx512f", "avx2", "sse2", "neon", "scalar64"]:
+    """name of the masking kernel resolved for this host at import"""
+    ...
+
+
+def get_stats() -> dict[str, int]:
+    """
+    snapshot of the hot-path counters: frames parsed/built, bytes
+    masked (total and vector vs scalar-tail split of the kernel),
+    allocation failures and calls per entry point
+
+    the counters are monotone, process-wide and maintained as plain
+    unsynchronised increments; readings under heavy threading are
+    approximate
+    """
+    ...
+
+
+def reset_stats() -> None:
+    """zero all hot-path counters"""
+    ...
+
+
+def build_file_header(
+        fd_or_path: int | str | bytes,
+        offset: int,
+        length: int,
+        opcode: Literal[1, 2, 8, 9, 10] | int = 2,
+        fin: Literal[0, 1] | int = 1,
+        /
+) -> bytes:
+    """
+    create the exact header for an unmasked frame whose payload is the
+    file region [offset, offset + length)
+
+    the file is stat'ed and the region validated against its size; send
+    the returned header with ``socket.send`` and the body straight from
+    the page cache with ``os.sendfile`` (server-to-client frames are
+    unmasked, which makes this legal)
+    """
+    ...
+
+
 def masking(
         payload: bytes,
         mask: bytes,
@@ -60,6 +542,92 @@ def masking(
     ...
 
 
+def masking_offset(
+        payload: bytes,
+        mask: bytes,
+        start_offset: int,
+        /
+) -> bytes:
+    """
+    apply masking to a WebSocket payload chunk as if it started at byte
+    `start_offset` of the frame payload (the 4-byte mask is rotated by
+    ``start_offset % 4``), for chunk-by-chunk [de]masking of payloads
+    in flight
+
+    - payload: bytes
+    - mask: 4 bytes
+    - start_offset: >= 0
+    """
+    ...
+
+
+def masking_inplace(
+        buffer: bytearray | memoryview,
+        mask: bytes,
+        /
+) -> None:
+    """
+    apply masking to a writable WebSocket payload buffer in place
+
+    - buffer: any writable object supporting the buffer protocol
+    - mask: 4 bytes
+    """
+    ...
+
+
+def parse_http_headers(
+        streamdata: bytes | bytearray | memoryview,
+        /
+) -> tuple[bytes, list[tuple[bytes, bytes]]]:
+    """
+    parse a http header block (e.g. the WebSocket upgrade request) in
+    one pass over the input
+
+    returns: (
+        - l1: the request/status line,
+        - items: list of (key, value) pairs, keys stripped
+    )
+    """
+    ...
+
+
+def build_http_headers(
+        l1: bytes,
+        items: list[tuple[bytes, bytes]],
+        /
+) -> bytes:
+    """
+    serialize a http header block terminated by an empty line
+
+    - l1: the request/status line
+    - items: sequence of (key, value) bytes pairs
+    """
+    ...
+
+
+def make_accept_key(
+        b64key: bytes,
+        /
+) -> bytes:
+    """
+    compute the Sec-WebSocket-Accept value for `b64key` (append the
+    magic GUID, SHA-1, base64) in one call without intermediate objects
+    """
+    ...
+
+
+def make_response_bytes(
+        b64key: bytes,
+        version: bytes = b"13",
+        /
+) -> bytes:
+    """
+    emit the complete minimum 101 handshake response for `b64key` from a
+    preformatted template with the accept key and version patched in
+    """
+    ...
+
+
 def read_header(
         two_bytes: bytes,
         /
@@ -3,6 +3,8 @@ import socket
 import threading
 import unittest
 import webbrowser
+from base64 import b64encode
+from hashlib import sha1
 from pathlib import Path
 from sys import argv
 from time import perf_counter_ns
@@ -11,6 +13,7 @@ from wsdatautil import _wsframecoder
 from wsdatautil import Frame, OPCODES, CLOSECODES, StreamReader
 from wsdatautil import get_close_code_and_message_from_frame
 from wsdatautil import HandshakeRequest
+from wsdatautil import PermessageDeflate, PayloadTooLong, ProgressiveStreamReader
 
 
 class TestWebSocketFrame(unittest.TestCase):
@@ -272,6 +275,316 @@ class TestWebSocketFrame(unittest.TestCase):
         self.assertEqual(parsed_frame.amount, mb_amount)
 
 
+class TestCSupplements(unittest.TestCase):
+
+    def test_accept_key(self):
+        # The hand-rolled SHA-1 + base64 must match the reference implementation,
+        # including the block padding boundaries (55/56/64 byte inputs).
+        guid = b"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+        # RFC 6455 section 1.3 sample handshake
+        self.assertEqual(
+            _wsframecoder.make_accept_key(b"dGhlIHNhbXBsZSBub25jZQ=="),
+            b"s3pPLMBiTxaQ9kYGzzhZRbK+xOo="
+        )
+
+        for key_len in (0, 1, 18, 19, 20, 27, 28, 55, 56, 57, 63, 64, 65, 200):
+            with self.subTest(key_len=key_len):
+                key = b"k" * key_len
+                self.assertEqual(
+                    _wsframecoder.make_accept_key(key),
+                    b64encode(sha1(key + guid).digest())
+                )
+
+        # the templated 101 response must match the generic slow path byte for byte
+        request = HandshakeRequest(b"dGhlIHNhbXBsZSBub25jZQ==")
+        self.assertEqual(
+            request.make_response_bytes(),
+            request.make_response().to_streamdata()
+        )
+
+    def test_http_header_parsing(self):
+        # well-formed request block
+        l1, items = _wsframecoder.parse_http_headers(
+            b'GET /chat HTTP/1.1\r\n'
+            b'Host: example.com\r\n'
+            b'Upgrade: websocket\r\n'
+            b'Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n'
+            b'\r\n'
+        )
+        self.assertEqual(l1, b'GET /chat HTTP/1.1')
+        self.assertEqual(items, [
+            (b'Host', b'example.com'),
+            (b'Upgrade', b'websocket'),
+            (b'Sec-WebSocket-Key', b'dGhlIHNhbXBsZSBub25jZQ=='),
+        ])
+
+        # duplicate headers are preserved in order
+        _, items = _wsframecoder.parse_http_headers(b'GET / HTTP/1.1\r\nHost: x\r\nHost: y\r\n\r\n')
+        self.assertEqual(items, [(b'Host', b'x'), (b'Host', b'y')])
+
+        # lines without the ': ' separator are rejected, including folded
+        # continuation lines (obsolete per RFC 7230)
+        for streamdata in (
+                b'GET / HTTP/1.1\r\nbroken\r\n\r\n',
+                b'GET / HTTP/1.1\r\nA: b\r\n folded continuation\r\n\r\n',
+        ):
+            with self.subTest(streamdata=streamdata):
+                with self.assertRaises(ValueError):
+                    _wsframecoder.parse_http_headers(streamdata)
+
+        # truncated input: whatever is complete is returned
+        l1, items = _wsframecoder.parse_http_headers(b'GET / HTTP/1.1')
+        self.assertEqual((l1, items), (b'GET / HTTP/1.1', []))
+        l1, items = _wsframecoder.parse_http_headers(b'GET / HTTP/1.1\r\nA: b')
+        self.assertEqual((l1, items), (b'GET / HTTP/1.1', [(b'A', b'b')]))
+        self.assertEqual(_wsframecoder.parse_http_headers(b''), (b'', []))
+
+        # header bytes are opaque: non-ascii keys/values pass through
+        l1, items = _wsframecoder.parse_http_headers('GET / HTTP/1.1\r\nKöln: ü\r\n\r\n'.encode())
+        self.assertEqual(items, [('Köln'.encode(), 'ü'.encode())])
+
+        # oversized lines survive the round trip
+        big = b'v' * 100000
+        l1, items = _wsframecoder.parse_http_headers(b'GET / HTTP/1.1\r\nBig: ' + big + b'\r\n\r\n')
+        self.assertEqual(items, [(b'Big', big)])
+
+        # build is the inverse of parse
+        l1 = b'HTTP/1.1 101 Switching Protocols'
+        items = [(b'Upgrade', b'websocket'), (b'Connection', b'Upgrade'), (b'Big', big)]
+        streamdata = _wsframecoder.build_http_headers(l1, items)
+        self.assertEqual(_wsframecoder.parse_http_headers(streamdata), (l1, items))
+
+    def test_handshake(self):
+        request = HandshakeRequest(b'dGhlIHNhbXBsZSBub25jZQ==')
+        parsed = HandshakeRequest.from_streamdata(request.to_streamdata())
+        self.assertEqual(parsed.l1, request.l1)
+        self.assertEqual(list(parsed.items()), list(request.items()))
+
+        response = parsed.make_response()
+        self.assertEqual(response[b'Sec-WebSocket-Accept'], b's3pPLMBiTxaQ9kYGzzhZRbK+xOo=')
+        self.assertEqual(parsed.make_response_bytes(), response.to_streamdata())
+        self.assertTrue(
+            parsed.make_response_bytes(b'8').endswith(b'Sec-WebSocket-Version: 8\r\n\r\n')
+        )
+
+        # from_streamdata starts from the constructor defaults, so a request
+        # without the key header answers with the accept of the default key
+        keyless = HandshakeRequest.from_streamdata(b'GET / HTTP/1.1\r\nHost: x\r\n\r\n')
+        self.assertEqual(
+            keyless.make_response()[b'Sec-WebSocket-Accept'],
+            _wsframecoder.make_accept_key(keyless[b'Sec-WebSocket-Key'])
+        )
+
+    def test_utf8_validation(self):
+        # Hoehrmann DFA with the vectorized ascii skip: pad the interesting
+        # sequence behind a long ascii run so it lands after the simd blocks.
+        pad = b'a' * 40
+        valid = (
+            b'',
+            pad,
+            "äöü€😀".encode(),
+            pad + "é".encode(),
+            pad + b'\xf0\x90\x80\x80',  # U+10000, 4 byte sequence
+        )
+        invalid = (
+            b'\x80',                    # lone continuation byte
+            b'\xc3',                    # truncated 2 byte sequence
+            pad + b'\xc3',
+            b'\xc0\xaf',                # overlong encoding
+            b'\xed\xa0\x80',            # utf-16 surrogate
+            pad + b'\xf0\x80\x80\x80',  # overlong 4 byte sequence
+            b'\xff',
+        )
+        for payload in valid:
+            with self.subTest(payload=payload):
+                frame = _wsframecoder.build(1, 0, 0, 0, OPCODES.TEXT, b'', payload)
+                self.assertEqual(_wsframecoder.parse(frame, True, True)[9], payload)
+        for payload in invalid:
+            with self.subTest(payload=payload):
+                frame = _wsframecoder.build(1, 0, 0, 0, OPCODES.TEXT, b'', payload)
+                with self.assertRaises(ValueError):
+                    _wsframecoder.parse(frame, True, True)
+
+    def test_permessage_deflate(self):
+        client = PermessageDeflate()
+        server = PermessageDeflate()
+        payload = b'repetitive payload ' * 64
+
+        # context takeover: the sync flush tail is stripped/re-appended per
+        # message and the window carries over, so later messages shrink
+        sizes = []
+        for _ in range(3):
+            encoded = client.encode_frame(Frame(payload, OPCODES.TEXT))
+            self.assertEqual(encoded.rsv1, 1)
+            self.assertFalse(encoded.payload.endswith(b'\x00\x00\xff\xff'))
+            sizes.append(len(encoded.payload))
+            decoded = server.decode_frame(encoded)
+            self.assertEqual(decoded.payload, payload)
+            self.assertEqual(decoded.rsv1, 0)
+        self.assertLess(sizes[-1], sizes[0])
+
+        # whole-message contract: fragmented input is rejected
+        with self.assertRaises(ValueError):
+            client.encode_frame(Frame(b'x', OPCODES.TEXT, fin=0))
+        with self.assertRaises(ValueError):
+            client.encode_frame(Frame(b'x', OPCODES.CONTINUE, fin=1))
+        with self.assertRaises(ValueError):
+            server.decode_frame(Frame(b'x', OPCODES.TEXT, fin=0, rsv1=1))
+
+        # control frames and uncompressed frames pass through unchanged
+        ping = Frame(b'', OPCODES.PING)
+        self.assertIs(client.encode_frame(ping), ping)
+        plain = Frame(b'plain', OPCODES.TEXT)
+        self.assertIs(server.decode_frame(plain), plain)
+
+    def test_stream_reader_chunk_boundaries(self):
+        frames = [
+            Frame(b'first', OPCODES.TEXT, mask=b'\x01\x02\x03\x04'),
+            Frame(b'a' * 200, OPCODES.BINARY, mask=b'\xff\x00\xff\x00'),
+            Frame(b'', OPCODES.PING, mask=b'\x05\x06\x07\x08'),
+            Frame(b'b' * 70000, OPCODES.BINARY, mask=b'\x09\x0a\x0b\x0c'),
+        ]
+        stream = b''.join(f.to_streamdata() for f in frames)
+
+        for chunk_size in (1, 2, 3, 7, 13, len(stream)):
+            with self.subTest(chunk_size=chunk_size):
+                reader = ProgressiveStreamReader(payloads_masked=True)
+                received = []
+                for pos in range(0, len(stream), chunk_size):
+                    received += reader.feed(stream[pos:pos + chunk_size])
+                self.assertEqual(len(received), len(frames))
+                for got, expected in zip(received, frames):
+                    self.assertEqual(got.payload, expected.payload)
+                    self.assertEqual(got.opcode, expected.opcode)
+
+    def test_recv_buffer_chunk_boundaries(self):
+        frames = [
+            Frame(b'first', OPCODES.TEXT, mask=b'\x01\x02\x03\x04'),
+            Frame(b'a' * 200, OPCODES.BINARY, mask=b'\xff\x00\xff\x00'),
+            Frame(b'b' * 70000, OPCODES.BINARY, mask=b'\x09\x0a\x0b\x0c'),
+        ]
+        stream = b''.join(f.to_streamdata() for f in frames)
+
+        for chunk_size in (1, 7, 1024, len(stream)):
+            with self.subTest(chunk_size=chunk_size):
+                buffer = _wsframecoder.RecvBuffer()
+                received = []
+                for pos in range(0, len(stream), chunk_size):
+                    chunk = stream[pos:pos + chunk_size]
+                    view = buffer.writable_tail(len(chunk))
+                    view[:len(chunk)] = chunk
+                    del view
+                    buffer.commit(len(chunk))
+                    received += buffer.read_frames()
+                self.assertEqual(buffer.pending, 0)
+                self.assertEqual(len(received), len(frames))
+                for got, expected in zip(received, frames):
+                    self.assertEqual(got[9], expected.payload)
+                    self.assertEqual(got[4], expected.opcode)
+
+    def test_frame_parser_chunk_boundaries(self):
+        frames = [
+            Frame(b'first', OPCODES.TEXT, mask=b'\x01\x02\x03\x04'),
+            Frame(b'a' * 200, OPCODES.BINARY),
+            Frame(b'b' * 70000, OPCODES.BINARY, mask=b'\x09\x0a\x0b\x0c'),
+        ]
+        stream = b''.join(f.to_streamdata() for f in frames)
+
+        for chunk_size in (1, 2, 13, len(stream)):
+            with self.subTest(chunk_size=chunk_size):
+                received = []
+                parser = _wsframecoder.FrameParser(received.append)
+                for pos in range(0, len(stream), chunk_size):
+                    parser.feed_data(stream[pos:pos + chunk_size])
+                self.assertEqual(len(received), len(frames))
+                for got, expected in zip(received, frames):
+                    self.assertEqual(got[9], expected.payload)
+                    self.assertEqual(got[4], expected.opcode)
+
+        # chunked payload delivery: bytes arrive demasked via on_payload_chunk
+        received = []
+        chunks = []
+        parser = _wsframecoder.FrameParser(received.append, chunks.append)
+        for pos in range(0, len(stream), 100):
+            parser.feed_data(stream[pos:pos + 100])
+        self.assertEqual(len(received), len(frames))
+        self.assertIsNone(received[0][9])
+        self.assertEqual(b''.join(chunks), b''.join(f.payload for f in frames))
+
+    def test_parallel_masking(self):
+        # the parallel split must produce the same bytes as the single
+        # kernel pass, including the unaligned tail and the mask rotation
+        # free 64-byte slice boundaries
+        mask = b'\x12\x34\x56\x78'
+        payloads = (
+            b'q' * (8 * 1024 * 1024),       # well above the threshold
+            b'q' * (8 * 1024 * 1024 + 13),  # unaligned tail
+            bytes(range(256)) * 4096,
+        )
+        try:
+            for payload in payloads:
+                with self.subTest(size=len(payload)):
+                    serial = _wsframecoder.masking(payload, mask)
+                    for workers in (2, 4):
+                        _wsframecoder.set_parallel_masking(workers, 1024 * 1024)
+                        self.assertEqual(_wsframecoder.masking(payload, mask), serial)
+                        # in-place variant takes the same parallel path
+                        buffer = bytearray(payload)
+                        _wsframecoder.masking_inplace(buffer, mask)
+                        self.assertEqual(bytes(buffer), serial)
+            # payloads below the threshold stay on the single pass
+            _wsframecoder.set_parallel_masking(4, 1024 * 1024)
+            small = b's' * 1024
+            self.assertEqual(
+                _wsframecoder.masking(small, mask),
+                bytes(b ^ mask[i & 3] for i, b in enumerate(small))
+            )
+        finally:
+            _wsframecoder.set_parallel_masking(0)
+
+    def test_truncated_header(self):
+        # extended length/mask fields claimed by the first two bytes but not
+        # present must raise instead of reading past the buffer
+        for header in (b'\x82\x7e', b'\x82\x7f', b'\x82\xfe', b'\x82\xff', b'\x82\x85'):
+            with self.subTest(header=header):
+                with self.assertRaises(ValueError):
+                    _wsframecoder.parse(header, True)
+                with self.assertRaises(ValueError):
+                    _wsframecoder.parse_frame(header, True)
+                with self.assertRaises(ValueError):
+                    _wsframecoder.parse_view(memoryview(header))
+                with self.assertRaises(ValueError):
+                    _wsframecoder.parse_into(header, True, bytearray(16))
+
+        # parse_partial reports the missing byte count instead
+        frame = Frame(b'b' * 70000, OPCODES.BINARY, mask=b'\x01\x02\x03\x04').to_streamdata()
+        parsed, needed = _wsframecoder.parse_partial(frame[:2], 0, True)
+        self.assertIsNone(parsed)
+        self.assertEqual(needed, 12)  # 8 length bytes + 4 mask bytes
+        parsed, consumed = _wsframecoder.parse_partial(frame, 0, True)
+        self.assertEqual(consumed, len(frame))
+        self.assertEqual(parsed[9], b'b' * 70000)
+
+    def test_payload_too_long(self):
+        frame = Frame(b'b' * 70000, OPCODES.BINARY).to_streamdata()
+
+        # rejected right after the length decode, before any allocation
+        for call in (
+                lambda: _wsframecoder.parse(frame, True, False, 1024),
+                lambda: _wsframecoder.parse_all(frame, True, 1024),
+                lambda: StreamReader(payloads_masked=False, max_payload_len=1024).feed(frame),
+        ):
+            with self.subTest(call=call):
+                with self.assertRaises(PayloadTooLong) as ctx:
+                    call()
+                self.assertEqual(ctx.exception.args[1], 70000)
+        self.assertTrue(issubclass(PayloadTooLong, ValueError))
+
+        # under the limit everything still parses
+        self.assertEqual(_wsframecoder.parse(frame, True, False, 70000)[9], b'b' * 70000)
+
+
 if __name__ == '__main__':
     flags = str().join(argv[1:]).upper()
 